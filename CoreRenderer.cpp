@@ -0,0 +1,160 @@
+#define GLEW_STATIC
+
+#include <GL/glew.h>
+#include <glm/gtc/type_ptr.hpp>
+#include "CoreRenderer.h"
+#include "packedVertex.h"
+
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+CoreRenderer::CoreRenderer()
+        : program(0), vao(0), buffer(0), indices(0), offset(0), compact(false), normal1010102(false),
+          specified(false), respecifications(0), modelViewLoc(-1), projectionLoc(-1), normalLoc(-1),
+          positionScaleLoc(-1), gpuWavesLoc(-1), timeLoc(-1), waveCountLoc(-1), wavesLoc(-1)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// destructor. Runs after the GL context is gone, the driver frees the rest.
+///////////////////////////////////////////////////////////////////////////////
+CoreRenderer::~CoreRenderer()
+{
+}
+
+
+
+bool CoreRenderer::isSupported()
+{
+    return GLEW_VERSION_3_3;
+}
+
+
+
+bool CoreRenderer::create(unsigned program)
+{
+    if (!program)
+        return false;
+
+    this->program = program;
+    modelViewLoc = glGetUniformLocation(program, "ModelViewMatrix");
+    projectionLoc = glGetUniformLocation(program, "ProjectionMatrix");
+    normalLoc = glGetUniformLocation(program, "NormalMatrix");
+    positionScaleLoc = glGetUniformLocation(program, "PositionScale");
+    gpuWavesLoc = glGetUniformLocation(program, "GpuWaves");
+    timeLoc = glGetUniformLocation(program, "Time");
+    waveCountLoc = glGetUniformLocation(program, "WaveCount");
+    wavesLoc = glGetUniformLocation(program, "Waves");
+
+    if (!vao)
+        glGenVertexArrays(1, &vao);
+    specified = false;
+    return true;
+}
+
+
+
+void CoreRenderer::release()
+{
+    // nothing to do (and maybe no GL yet) without a vertex array
+    if (vao)
+        glDeleteVertexArrays(1, &vao);
+    vao = 0;
+    program = 0;
+    specified = false;
+}
+
+
+
+bool CoreRenderer::isCreated() const
+{
+    return vao != 0;
+}
+
+
+
+void CoreRenderer::setVertices(unsigned buffer, size_t offset, bool compact, bool normal1010102, unsigned indices)
+{
+    if (specified && buffer == this->buffer && offset == this->offset && compact == this->compact &&
+        normal1010102 == this->normal1010102 && indices == this->indices)
+        return;
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (compact)
+    {
+        // positions stay integers, scaled by PositionScale in the shader
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(PackedVertex), BUFFER_OFFSET(offset));
+        if (normal1010102)
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex),
+                                  BUFFER_OFFSET(offset + offsetof(PackedVertex, n)));
+        else
+            glVertexAttribPointer(1, 3, GL_BYTE, GL_TRUE, sizeof(PackedVertex),
+                                  BUFFER_OFFSET(offset + offsetof(PackedVertex, n)));
+    }
+    else
+    {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(offset));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), BUFFER_OFFSET(offset + sizeof(vec3f)));
+    }
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    // the element buffer binding is part of the vertex array
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    this->buffer = buffer;
+    this->offset = offset;
+    this->compact = compact;
+    this->normal1010102 = normal1010102;
+    this->indices = indices;
+    if (specified)
+        ++respecifications;
+    specified = true;
+}
+
+
+
+void CoreRenderer::begin(const glm::mat4 &modelView, const glm::mat4 &projection, const glm::mat3 &normal,
+                         float positionScale)
+{
+    glUseProgram(program);
+    glUniformMatrix4fv(modelViewLoc, 1, GL_FALSE, glm::value_ptr(modelView));
+    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    glUniformMatrix3fv(normalLoc, 1, GL_FALSE, glm::value_ptr(normal));
+    glUniform1f(positionScaleLoc, positionScale);
+    glBindVertexArray(vao);
+}
+
+
+
+void CoreRenderer::setWaves(bool gpu, float time, const sinewave *waves, int count)
+{
+    glUniform1i(gpuWavesLoc, gpu ? 1 : 0);
+    if (!gpu)
+        return;
+    glUniform1f(timeLoc, time);
+    glUniform1i(waveCountLoc, count);
+    if (count > 0)
+        glUniform3fv(wavesLoc, count, &waves[0].A);
+}
+
+
+
+void CoreRenderer::end()
+{
+    glBindVertexArray(0);
+}
+
+
+
+unsigned CoreRenderer::getRespecifications() const
+{
+    return respecifications;
+}
@@ -0,0 +1,59 @@
+#ifndef TOWERDEFENSESDL_CORERENDERER_H
+#define TOWERDEFENSESDL_CORERENDERER_H
+
+#include <stddef.h>
+#include "wave.h"
+
+/*
+ * The grid drawn the GL 3.3 core-profile way (core.vert / core.frag).
+ *
+ * One vertex array object holds the generic attribute layout, position at
+ * location 0 and normal at 1, in the full or the compact format, together
+ * with the index buffer; a draw is glBindVertexArray() and the elements.
+ * The matrices are built with glm and passed as uniforms, the light and
+ * material are shader constants: nothing of the matrix stack, client state
+ * or fixed-function lighting is used.
+ *
+ * The persistent upload ring draws from a different segment every frame,
+ * so there the attribute pointers are re-specified per frame; that is
+ * counted.
+ */
+class CoreRenderer
+{
+public:
+    CoreRenderer();                             // default constructor, no vertex array
+    ~CoreRenderer();                            // nothing, call release() while GL is up
+
+    static bool isSupported();                  // needs a GL context and glewInit()
+
+    bool     create(unsigned program);          // core.vert + core.frag linked into program
+    void     release();
+    bool     isCreated() const;
+
+    // point the attributes at the vertices at offset in buffer, only when
+    // any of it changed since the last call
+    void     setVertices(unsigned buffer, size_t offset, bool compact, bool normal1010102, unsigned indices);
+
+    // bind the vertex array and the program, set the matrices
+    void     begin(const glm::mat4 &modelView, const glm::mat4 &projection, const glm::mat3 &normal,
+                   float positionScale);
+    // sum the waves in the shader (gpu), or draw the vertices as they are
+    void     setWaves(bool gpu, float time, const sinewave *waves, int count);
+    void     end();
+
+    unsigned getRespecifications() const;       // setVertices() calls that changed the layout
+
+
+private:
+    unsigned program;
+    unsigned vao;
+    unsigned buffer, indices;
+    size_t   offset;
+    bool     compact, normal1010102;
+    bool     specified;
+    unsigned respecifications;
+    int      modelViewLoc, projectionLoc, normalLoc, positionScaleLoc;
+    int      gpuWavesLoc, timeLoc, waveCountLoc, wavesLoc;
+};
+
+#endif //TOWERDEFENSESDL_CORERENDERER_H
@@ -0,0 +1,94 @@
+#include "DirtyRanges.h"
+#include <algorithm>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+DirtyRanges::DirtyRanges()
+{
+}
+
+
+
+void DirtyRanges::clear()
+{
+    ranges.clear();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// insert [begin, end) in order, swallowing every range it overlaps or
+// touches. The lists stay short (a few ranges per frame), so a linear pass
+// is all it takes.
+///////////////////////////////////////////////////////////////////////////////
+void DirtyRanges::add(unsigned begin, unsigned end)
+{
+    if (begin >= end)
+        return;
+
+    std::vector<Range>::iterator first = ranges.begin();
+    while (first != ranges.end() && first->end < begin)
+        ++first;
+    std::vector<Range>::iterator last = first;
+    while (last != ranges.end() && last->begin <= end)
+    {
+        begin = std::min(begin, last->begin);
+        end = std::max(end, last->end);
+        ++last;
+    }
+    Range merged = {begin, end};
+    first = ranges.erase(first, last);
+    ranges.insert(first, merged);
+}
+
+
+
+void DirtyRanges::add(const DirtyRanges &other)
+{
+    for (size_t i = 0; i < other.ranges.size(); ++i)
+        add(other.ranges[i].begin, other.ranges[i].end);
+}
+
+
+
+void DirtyRanges::coalesce(unsigned gap)
+{
+    if (ranges.empty())
+        return;
+
+    size_t out = 0;
+    for (size_t i = 1; i < ranges.size(); ++i)
+    {
+        if (ranges[i].begin - ranges[out].end <= gap)
+            ranges[out].end = ranges[i].end;
+        else
+            ranges[++out] = ranges[i];
+    }
+    ranges.resize(out + 1);
+}
+
+
+
+bool DirtyRanges::empty() const
+{
+    return ranges.empty();
+}
+
+
+
+const std::vector<DirtyRanges::Range> &DirtyRanges::getRanges() const
+{
+    return ranges;
+}
+
+
+
+size_t DirtyRanges::getVertexCount() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < ranges.size(); ++i)
+        count += ranges[i].end - ranges[i].begin;
+    return count;
+}
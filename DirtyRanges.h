@@ -0,0 +1,35 @@
+#ifndef TOWERDEFENSESDL_DIRTYRANGES_H
+#define TOWERDEFENSESDL_DIRTYRANGES_H
+
+#include <stddef.h>
+#include <vector>
+
+// Vertex ranges [begin, end) changed since the last upload, kept sorted
+// and merged so overlapping or touching ranges go up as one.
+class DirtyRanges
+{
+public:
+    typedef struct {
+        unsigned begin, end;
+    } Range;
+
+    DirtyRanges();                              // default constructor, nothing dirty
+
+    void     clear();
+    void     add(unsigned begin, unsigned end);
+    void     add(const DirtyRanges &other);
+
+    // merge neighbours at most gap vertices apart; one larger upload is
+    // cheaper than many small ones
+    void     coalesce(unsigned gap);
+
+    bool     empty() const;
+    const std::vector<Range> &getRanges() const;
+    size_t   getVertexCount() const;            // sum over the ranges
+
+
+private:
+    std::vector<Range> ranges;
+};
+
+#endif //TOWERDEFENSESDL_DIRTYRANGES_H
@@ -0,0 +1,356 @@
+#include "GridBuilder.h"
+#include "gridAlloc.h"
+#include "Timer.h"
+#include <climits>
+#include <stdint.h>
+#include <utility>
+
+static const GridArrays EMPTY_GRID = {NULL, NULL, 0, 0, 0, 0, {0, 0, 0, 0, 0, 0}};
+
+
+bool buildGridArrays(GridArrays *arrays, unsigned rows, unsigned cols, const sinewave *waves, unsigned nWaves,
+                     double time, TrigTier tier, const std::function<bool()> &cancelled)
+{
+    // the counts are 32-bit and the strips hold two indices per vertex
+    uint64_t vertexCount = ((uint64_t) rows + 1) * ((uint64_t) cols + 1);
+    if (!rows || !cols || vertexCount * 2 > UINT_MAX)
+        return false;
+
+    unsigned nVertices = (unsigned) vertexCount;
+    unsigned nIndices = nVertices * 2;
+
+    // grow only: shrinking and small steps reuse the arrays of an earlier grid
+    if (nVertices > arrays->vertexCapacity)
+    {
+        arrays->vertexCapacity = (unsigned) gridGrowCapacity(arrays->vertexCapacity, nVertices);
+        gridFree(arrays->vertices);
+        arrays->vertices = (Vertex *) gridAlloc(arrays->vertexCapacity * sizeof(Vertex));
+    }
+    if (nIndices > arrays->indexCapacity)
+    {
+        arrays->indexCapacity = (unsigned) gridGrowCapacity(arrays->indexCapacity, nIndices);
+        gridFree(arrays->indices);
+        arrays->indices = (unsigned *) gridAlloc(arrays->indexCapacity * sizeof(unsigned));
+    }
+    if (!arrays->vertices || !arrays->indices)
+    {
+        freeGridArrays(arrays);
+        return false;
+    }
+
+    float dz = 2 / (float) rows;
+    float dx = 2 / (float) cols;
+    arrays->nVertices = nVertices;
+    arrays->nIndices = nIndices;
+    arrays->grid = {rows, cols, -1.0f, -1.0f, dx, dz};
+
+    /* Vertices */
+    Vertex *vtx = arrays->vertices;
+    for (unsigned i = 0; i <= cols; i++) {
+        if (cancelled && cancelled())
+            return false;
+        float x = -1.0f + i * dx;
+        for (unsigned j = 0; j <= rows; j++) {
+            float z = -1.0f + j * dz;
+            float y = 0, dydx = 0;
+            for (unsigned w = 0; w < nWaves; w++) {
+                float s, c;
+                trigSinCosIn(tier, (float) (waves[w].k * x * x + waves[w].k * z * z + waves[w].w * time), &s, &c);
+                y += waves[w].A * s;
+                dydx += waves[w].k * waves[w].A * c;
+            }
+
+            vtx->r = {x, y, z};
+            vtx->n = {-dydx, 1.0f, 0};
+            vtx++;
+        }
+    }
+
+    /* Indices */
+    unsigned *idx = arrays->indices;
+    for (unsigned i = 0; i < cols; i++) {
+        for (unsigned j = 0; j <= rows; j++) {
+            *idx++ = i * (rows + 1) + j;
+            *idx++ = (i + 1) * (rows + 1) + j;
+        }
+    }
+    return true;
+}
+
+void freeGridArrays(GridArrays *arrays)
+{
+    gridFree(arrays->vertices);
+    gridFree(arrays->indices);
+    *arrays = EMPTY_GRID;
+}
+
+// more than half again as much room as nVertices and nIndices need, more
+// than a grow would have left
+static bool isOversized(const GridArrays &arrays, unsigned nVertices, unsigned nIndices)
+{
+    return arrays.vertexCapacity > gridGrowCapacity(nVertices, nVertices) ||
+           arrays.indexCapacity > gridGrowCapacity(nIndices, nIndices);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+GridBuilder::GridBuilder()
+        : work(EMPTY_GRID), done(EMPTY_GRID), doneGeneration(0), ready(false), heldBytes(0),
+          spareVertexCapacity(0), spareIndexCapacity(0), generation(0),
+          pending(false), building(false), quit(false), buildTime(0), cancelledBuilds(0), failedBuilds(0)
+{
+    job.orderIndices = false;
+    job.order = ORDER_STRIPS;
+    job.stitch = STITCH_RESTART;
+    job.cacheSize = 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// destructor
+///////////////////////////////////////////////////////////////////////////////
+GridBuilder::~GridBuilder()
+{
+    if (thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+            ++generation;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+    freeGridArrays(&work);
+    freeGridArrays(&done);
+}
+
+
+
+void GridBuilder::request(unsigned rows, unsigned cols, const sinewave *waves, unsigned nWaves, double time)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++generation;
+        job.rows = rows;
+        job.cols = cols;
+        job.waves.assign(waves, waves + nWaves);
+        job.time = time;
+        job.tier = trigTier;
+        pending = true;
+        ready = false;
+        dropDone();
+        if (!thread.joinable())
+            thread = std::thread(&GridBuilder::threadLoop, this);
+    }
+    wake.notify_one();
+}
+
+
+
+void GridBuilder::cancel()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    ++generation;
+    pending = false;
+    ready = false;
+    dropDone();
+    idle.wait(lock, [this] { return !building; });
+}
+
+
+
+void GridBuilder::setIndexOrder(bool enabled, IndexOrder order, StitchMode stitch, unsigned cacheSize)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    job.orderIndices = enabled;
+    job.order = order;
+    job.stitch = stitch;
+    job.cacheSize = cacheSize;
+}
+
+
+
+bool GridBuilder::isBusy() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending || building;
+}
+
+
+
+bool GridBuilder::isReady() const
+{
+    return ready.load(std::memory_order_acquire);
+}
+
+
+
+bool GridBuilder::take(GridArrays *current, SingleIndices *currentIndices)
+{
+    if (!ready.load(std::memory_order_acquire))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!ready || doneGeneration != generation)
+        return false;
+    std::swap(*current, done);
+    std::swap(*currentIndices, doneIndices);
+    ready = false;
+
+    // the worker is idle: keep the arrays given back as the one spare set
+    // for the next build, unless they are larger than the grid now in use
+    freeGridArrays(&work);
+    std::swap(work, done);
+    if (isOversized(work, current->nVertices, current->nIndices))
+        freeGridArrays(&work);
+    doneIndices = SingleIndices();
+    countHeld(0);
+    return true;
+}
+
+
+
+size_t GridBuilder::getHeldBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return heldBytes;
+}
+
+
+
+void GridBuilder::getSpareCapacity(unsigned *vertexCapacity, unsigned *indexCapacity) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    *vertexCapacity = spareVertexCapacity;
+    *indexCapacity = spareIndexCapacity;
+}
+
+
+
+double GridBuilder::getBuildTimeInMilliSec() const
+{
+    return buildTime;
+}
+
+
+
+unsigned GridBuilder::getCancelledBuilds() const
+{
+    return cancelledBuilds;
+}
+
+
+
+unsigned GridBuilder::getFailedBuilds() const
+{
+    return failedBuilds;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// free a finished grid nobody will take any more
+///////////////////////////////////////////////////////////////////////////////
+void GridBuilder::dropDone()
+{
+    freeGridArrays(&done);
+    doneIndices = SingleIndices();
+    countHeld(0);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// publish what work and done hold, for the memory budget. Called wherever
+// they change hands or size. work grows during a build without the lock,
+// so when one starts for nVertices it is counted at the capacity
+// buildGridArrays() is going to give it.
+///////////////////////////////////////////////////////////////////////////////
+void GridBuilder::countHeld(unsigned nVertices)
+{
+    size_t vertices = work.vertexCapacity;
+    size_t indices = work.indexCapacity;
+    if (nVertices > vertices)
+        vertices = gridGrowCapacity(vertices, nVertices);
+    if ((size_t) nVertices * 2 > indices)
+        indices = gridGrowCapacity(indices, (size_t) nVertices * 2);
+
+    heldBytes = vertices * sizeof(Vertex) + indices * sizeof(unsigned) +
+                (size_t) done.vertexCapacity * sizeof(Vertex) + (size_t) done.indexCapacity * sizeof(unsigned);
+    spareVertexCapacity = (unsigned) vertices;
+    spareIndexCapacity = (unsigned) indices;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// wait for a job, build it into work, then swap work and done. A grid not
+// taken before the next request() or cancel() is freed then, and take()
+// frees whatever is more than one spare set.
+// A build that stops without being cancelled was refused or ran out of
+// memory.
+///////////////////////////////////////////////////////////////////////////////
+void GridBuilder::threadLoop()
+{
+    while (true)
+    {
+        Job next;
+        unsigned gen;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return quit || pending; });
+            if (quit)
+                return;
+            next = job;
+            gen = generation;
+            pending = false;
+            building = true;
+
+            // a small grid gets arrays of its own instead of a large spare set
+            uint64_t nVertices = ((uint64_t) next.rows + 1) * ((uint64_t) next.cols + 1);
+            bool fits = nVertices * 2 <= UINT_MAX;
+            if (fits && isOversized(work, (unsigned) nVertices, (unsigned) nVertices * 2))
+                freeGridArrays(&work);
+            countHeld(fits ? (unsigned) nVertices : 0);
+        }
+
+        Timer timer;
+        timer.start();
+        auto cancelled = [this, gen] { return generation.load() != gen; };
+        bool built = buildGridArrays(&work, next.rows, next.cols, next.waves.data(), (unsigned) next.waves.size(),
+                                     next.time, next.tier, cancelled);
+        workIndices.rows = 0;
+        if (built && next.orderIndices)
+            built = orderSingleIndices(&workIndices, next.rows, next.cols, next.order, next.stitch, next.cacheSize,
+                                       cancelled);
+        timer.stop();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            building = false;
+            if (built && gen == generation)
+            {
+                std::swap(work, done);
+                std::swap(workIndices, doneIndices);
+                doneGeneration = gen;
+                ready.store(true, std::memory_order_release);
+                buildTime = (float) timer.getElapsedTimeInMilliSec();
+            }
+            else if (gen != generation)
+            {
+                ++cancelledBuilds;
+            }
+            else
+            {
+                ++failedBuilds;
+            }
+            countHeld(0);
+        }
+        idle.notify_all();
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef TOWERDEFENSESDL_GRIDBUILDER_H
+#define TOWERDEFENSESDL_GRIDBUILDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "fastTrig.h"
+#include "gridIndex.h"
+#include "waveKernel.h"
+
+// Vertex and index arrays of one grid. The arrays come from gridAlloc() and
+// only grow, a somewhat smaller grid reuses them.
+typedef struct {
+    Vertex *vertices;
+    unsigned *indices;
+    unsigned nVertices, nIndices;
+    unsigned vertexCapacity, indexCapacity;
+    WaveGrid grid;
+} GridArrays;
+
+// Fill arrays with the rows x cols grid over [-1, 1]^2: sine wave heights
+// and slopes at time, then the triangle strip indices, one strip per
+// column. cancelled (may be empty) is polled once per column; returns false
+// if it fired, leaving the arrays half written. A grid with more than
+// UINT_MAX indices is refused with the arrays untouched, see TiledGrid.
+bool buildGridArrays(GridArrays *arrays, unsigned rows, unsigned cols, const sinewave *waves, unsigned nWaves,
+                     double time, TrigTier tier, const std::function<bool()> &cancelled);
+
+void freeGridArrays(GridArrays *arrays);
+
+// Builds grids on a worker thread so a resize never blocks a frame. The
+// renderer keeps its arrays until take() swaps the finished grid in under a
+// short lock; the arrays it gives back are kept for the next build, as the
+// only spare set, when they are no larger than the new grid. A
+// newer request() or cancel() makes a running build stop at its next
+// column and frees a finished grid that was not taken yet. With
+// setIndexOrder() the single-draw indices are ordered in the same job, so
+// the renderer only has to upload them.
+class GridBuilder
+{
+public:
+    GridBuilder();                              // default constructor, no thread until the first request
+    ~GridBuilder();                             // stops the thread, frees its arrays
+
+    // build rows x cols with a copy of waves, replacing any pending request
+    void     request(unsigned rows, unsigned cols, const sinewave *waves, unsigned nWaves, double time);
+    void     cancel();                          // drop the pending grid, returns once the worker let go of it
+    // order the single-draw indices of the grids requested from now on (or not)
+    void     setIndexOrder(bool enabled, IndexOrder order, StitchMode stitch, unsigned cacheSize);
+    bool     isBusy() const;                    // a request is queued or being built
+    bool     isReady() const;                   // a grid is waiting for take()
+
+    // if a grid is ready, swap it and its single-draw indices (empty unless
+    // ordered) with current and return true; what was in current stays with
+    // the builder as its spare, or is freed
+    bool     take(GridArrays *current, SingleIndices *currentIndices);
+
+    size_t   getHeldBytes() const;              // arrays of the spare set and of a grid not taken yet
+    // capacities of the spare set the next build grows, or frees first when
+    // it is oversized for the grid
+    void     getSpareCapacity(unsigned *vertexCapacity, unsigned *indexCapacity) const;
+
+    double   getBuildTimeInMilliSec() const;    // last finished build
+    unsigned getCancelledBuilds() const;
+    unsigned getFailedBuilds() const;           // refused or out of memory
+
+
+private:
+    void     threadLoop();
+    void     dropDone();                        // with mutex held
+    void     countHeld(unsigned nVertices);     // with mutex held, nVertices of a starting build
+
+    typedef struct {
+        unsigned rows, cols;
+        std::vector<sinewave> waves;
+        double   time;
+        TrigTier tier;
+        bool     orderIndices;
+        IndexOrder order;
+        StitchMode stitch;
+        unsigned cacheSize;
+    } Job;
+
+    GridArrays work;                            // owned by the worker while it builds
+    GridArrays done;                            // finished grid, guarded by mutex
+    SingleIndices workIndices, doneIndices;     // as work and done
+    unsigned doneGeneration;                    // guarded by mutex
+    std::atomic<bool> ready;                    // done holds a grid not taken yet
+    size_t   heldBytes;                         // work and done, guarded by mutex
+    unsigned spareVertexCapacity, spareIndexCapacity;   // work's, guarded by mutex
+
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::condition_variable wake;               // signalled by request() and the destructor
+    std::condition_variable idle;               // signalled when a build ends
+    std::atomic<unsigned> generation;           // bumped by every request() and cancel()
+    Job      job;                               // guarded by mutex
+    bool     pending;                           // job not started yet, guarded by mutex
+    bool     building;                          // guarded by mutex
+    bool     quit;                              // guarded by mutex
+
+    std::atomic<float> buildTime;
+    std::atomic<unsigned> cancelledBuilds;
+    std::atomic<unsigned> failedBuilds;
+};
+
+#endif //TOWERDEFENSESDL_GRIDBUILDER_H
@@ -0,0 +1,202 @@
+#define GLEW_STATIC
+
+#include <GL/glew.h>
+#include "HeightmapTexture.h"
+#include "packedVertex.h"
+
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+HeightmapTexture::HeightmapTexture()
+        : texture(0), width(0), height(0), half(false), current(0), frameBytes(0), uploadedBytes(0), uploadTime(0)
+{
+    for (unsigned i = 0; i < PBOS; ++i)
+        pbos[i] = 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// destructor. Runs after the GL context is gone, the driver frees the rest.
+///////////////////////////////////////////////////////////////////////////////
+HeightmapTexture::~HeightmapTexture()
+{
+}
+
+
+
+bool HeightmapTexture::isSupported()
+{
+    if (!GLEW_VERSION_3_0)
+        return false;
+    GLint units = 0;
+    glGetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &units);
+    return units > 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// (re)allocate the texture and the pixel buffers for rows x cols and upload
+// the heights of initial through the first of them
+///////////////////////////////////////////////////////////////////////////////
+bool HeightmapTexture::create(unsigned rows, unsigned cols, bool half, const Vertex *initial)
+{
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (rows + 1 > (unsigned) maxSize || cols + 1 > (unsigned) maxSize)
+    {
+        release();
+        return false;
+    }
+
+    width = rows + 1;
+    height = cols + 1;
+    this->half = half;
+    frameBytes = (size_t) width * height * (half ? sizeof(unsigned short) : sizeof(float));
+
+    if (!texture)
+        glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, half ? GL_R16F : GL_R32F, width, height, 0, GL_RED,
+                 half ? GL_HALF_FLOAT : GL_FLOAT, NULL);
+    // the shader samples texel centres, and its normals the texels around
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (!pbos[0])
+        glGenBuffers(PBOS, pbos);
+    for (unsigned i = 0; i < PBOS; ++i)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[i]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, frameBytes, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    current = 0;
+
+    void *ptr = begin();
+    if (!ptr)
+    {
+        release();
+        return false;
+    }
+    if (half)
+        gatherHalfHeights((unsigned short *) ptr, initial, 0, width * height);
+    else
+        gatherHeights((float *) ptr, initial, 0, width * height);
+    end();
+    return true;
+}
+
+
+
+void HeightmapTexture::release()
+{
+    // nothing to do (and maybe no GL yet) without a texture
+    if (texture)
+    {
+        glDeleteTextures(1, &texture);
+        glDeleteBuffers(PBOS, pbos);
+    }
+    texture = 0;
+    for (unsigned i = 0; i < PBOS; ++i)
+        pbos[i] = 0;
+    width = height = 0;
+    frameBytes = 0;
+}
+
+
+
+bool HeightmapTexture::matches(unsigned rows, unsigned cols, bool half) const
+{
+    return texture && width == rows + 1 && height == cols + 1 && this->half == half;
+}
+
+
+
+void *HeightmapTexture::begin()
+{
+    clock.start();
+    current = (current + 1) % PBOS;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[current]);
+    void *ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frameBytes,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!ptr)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return ptr;
+}
+
+
+
+void HeightmapTexture::end()
+{
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // rows of half texels need not be a multiple of 4 bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, half ? 2 : 4);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, half ? GL_HALF_FLOAT : GL_FLOAT,
+                    BUFFER_OFFSET(0));
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    clock.stop();
+    uploadTime = clock.getElapsedTimeInMilliSec();
+    uploadedBytes = frameBytes;
+}
+
+
+
+unsigned HeightmapTexture::getTexture() const
+{
+    return texture;
+}
+
+
+
+unsigned HeightmapTexture::getWidth() const
+{
+    return width;
+}
+
+
+
+unsigned HeightmapTexture::getHeight() const
+{
+    return height;
+}
+
+
+
+bool HeightmapTexture::isHalf() const
+{
+    return half;
+}
+
+
+
+size_t HeightmapTexture::getBytes() const
+{
+    return frameBytes * (PBOS + 1);
+}
+
+
+
+size_t HeightmapTexture::getUploadedBytes() const
+{
+    return uploadedBytes;
+}
+
+
+
+double HeightmapTexture::getUploadTimeInMilliSec() const
+{
+    return uploadTime;
+}
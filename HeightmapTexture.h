@@ -0,0 +1,61 @@
+#ifndef TOWERDEFENSESDL_HEIGHTMAPTEXTURE_H
+#define TOWERDEFENSESDL_HEIGHTMAPTEXTURE_H
+
+#include <stddef.h>
+#include "Timer.h"
+#include "wave.h"
+
+/*
+ * The grid's heights as a texture for the vertex shader to displace a
+ * static grid with (GL 3.0 and a vertex texture unit).
+ *
+ * Texel (j, i) holds the height of vertex i*(rows+1)+j, so the texture is
+ * rows+1 texels wide, cols+1 high, and a frame of heights is laid out like
+ * the vertex array. Texels are R32F, or R16F at half the upload.
+ *
+ * A frame goes through a ring of PBOS pixel buffers: begin() maps the next
+ * one (invalidated, so the driver need not wait for the copy out of it
+ * three frames ago), end() unmaps it and starts glTexSubImage2D() from it,
+ * which returns before the copy is done.
+ */
+class HeightmapTexture
+{
+public:
+    static const unsigned PBOS = 3;
+
+    HeightmapTexture();                         // default constructor, no texture
+    ~HeightmapTexture();                        // nothing, call release() while GL is up
+
+    static bool isSupported();                  // needs a GL context and glewInit()
+
+    // a texture for rows x cols quads, filled from the heights of initial;
+    // false if the GL texture size limit is smaller
+    bool     create(unsigned rows, unsigned cols, bool half, const Vertex *initial);
+    void     release();
+    bool     matches(unsigned rows, unsigned cols, bool half) const;
+
+    void    *begin();                           // the next pixel buffer, texels as float or half
+    void     end();                             // unmap it and copy it into the texture
+
+    unsigned getTexture() const;
+    unsigned getWidth() const;                  // rows + 1
+    unsigned getHeight() const;                 // cols + 1
+    bool     isHalf() const;
+    size_t   getBytes() const;                  // texture and pixel buffers
+    size_t   getUploadedBytes() const;          // of the last frame
+    double   getUploadTimeInMilliSec() const;   // begin() to end() of the last frame
+
+
+private:
+    unsigned texture;
+    unsigned pbos[PBOS];
+    unsigned width, height;
+    bool     half;
+    unsigned current;
+    size_t   frameBytes;
+    size_t   uploadedBytes;
+    Timer    clock;
+    double   uploadTime;
+};
+
+#endif //TOWERDEFENSESDL_HEIGHTMAPTEXTURE_H
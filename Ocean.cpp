@@ -0,0 +1,332 @@
+#include "Ocean.h"
+#include "Timer.h"
+#include "fastTrig.h"
+#include <math.h>
+#include <random>
+
+static const float GRAVITY = 9.81f;
+static const unsigned OCEAN_MIN_SIZE = 16;
+static const unsigned OCEAN_MAX_SIZE = 1024;
+static const unsigned TRANSPOSE_TILE = 16;      // 16 complex = two cache lines per tile row
+
+// std::complex multiply goes through the NaN/Inf checking libgcc helper
+static inline std::complex<float> mul(std::complex<float> a, std::complex<float> b)
+{
+    return std::complex<float>(a.real() * b.real() - a.imag() * b.imag(),
+                               a.real() * b.imag() + a.imag() * b.real());
+}
+
+static unsigned nextPowerOfTwo(unsigned n)
+{
+    unsigned p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+Ocean::Ocean()
+        : size(0), windSpeed(12.0f), windX(1.0f), windZ(0.0f), patchLength(64.0f), amplitude(4e-4f),
+          dirty(true), fftTime(0.0)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// change the FFT size, clamped to [OCEAN_MIN_SIZE, OCEAN_MAX_SIZE]
+///////////////////////////////////////////////////////////////////////////////
+void Ocean::setSize(unsigned n)
+{
+    n = nextPowerOfTwo(n);
+    if (n < OCEAN_MIN_SIZE)
+        n = OCEAN_MIN_SIZE;
+    if (n > OCEAN_MAX_SIZE)
+        n = OCEAN_MAX_SIZE;
+    if (n == size)
+        return;
+
+    size = n;
+    dirty = true;
+}
+
+
+
+unsigned Ocean::getSize() const
+{
+    return size;
+}
+
+
+
+void Ocean::setWind(float speed, float dirX, float dirZ)
+{
+    float len = sqrtf(dirX * dirX + dirZ * dirZ);
+    if (len <= 0)
+        return;
+
+    windSpeed = speed;
+    windX = dirX / len;
+    windZ = dirZ / len;
+    dirty = true;
+}
+
+
+
+void Ocean::setPatchLength(float meters)
+{
+    patchLength = meters;
+    dirty = true;
+}
+
+
+
+double Ocean::getFFTTimeInMilliSec() const
+{
+    return fftTime;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// one frame: h(k, t) and the slope spectra, inverse FFT along kx, transpose,
+// inverse FFT along kz, then scatter into the vertices. The two real slope
+// fields share a transform with the height: h + i dh/dx is the transform of
+// H - kx H since both spectra are Hermitian.
+///////////////////////////////////////////////////////////////////////////////
+void Ocean::update(Vertex *dst, const WaveGrid *grid, float time, ThreadPool &pool)
+{
+    if (!dst || !grid)
+        return;
+
+    setSize(grid->rows > grid->cols ? grid->rows : grid->cols);
+    if (dirty)
+        buildSpectrum();
+
+    Timer t;
+    t.start();
+    pool.run(size / 2 + 1, 1, [=](unsigned begin, unsigned end) {
+        fillSpectrum(time, begin, end);
+    });
+    pool.run(size, 1, [=](unsigned begin, unsigned end) {
+        fftRows(heightSlopeX.data(), begin, end);
+        fftRows(slopeZ.data(), begin, end);
+    });
+    pool.run(size, 1, [=](unsigned begin, unsigned end) {
+        transpose(heightSlopeX.data(), heightSlopeXT.data(), begin, end);
+        transpose(slopeZ.data(), slopeZT.data(), begin, end);
+        fftRows(heightSlopeXT.data(), begin, end);
+        fftRows(slopeZT.data(), begin, end);
+    });
+    t.stop();
+    fftTime = t.getElapsedTimeInMilliSec();
+
+    unsigned count = (grid->rows + 1) * (grid->cols + 1);
+    pool.run(count, VERTEX_BAND_ALIGN, [=](unsigned begin, unsigned end) {
+        storeVertices(dst, grid, begin, end);
+    });
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Phillips spectrum P(k) = A exp(-1 / (k L)^2) / k^4 |k.w|^2 with L = V^2 / g,
+// damped above k = 1000 / L. h0(k) = (xr + i xi) sqrt(P(k) / 2) for standard
+// normal xr, xi; the seed is fixed so every run shows the same sea.
+// The Nyquist row and column are left empty so that the slope spectra stay
+// Hermitian and the packed transforms do not leak into each other.
+///////////////////////////////////////////////////////////////////////////////
+void Ocean::buildSpectrum()
+{
+    unsigned n = size;
+    h0.assign(n * n, Complex(0, 0));
+    omega.assign(n * n, 0.0f);
+    heightSlopeX.resize(n * n);
+    slopeZ.resize(n * n);
+    heightSlopeXT.resize(n * n);
+    slopeZT.resize(n * n);
+
+    // twiddles of the stage with butterfly span half start at half - 1
+    twiddle.resize(n > 1 ? n - 1 : 1);
+    for (unsigned half = 1; half < n; half <<= 1)
+        for (unsigned k = 0; k < half; ++k)
+            twiddle[half - 1 + k] = Complex(cosf((float) M_PI * k / half), sinf((float) M_PI * k / half));
+
+    unsigned bits = 0;
+    while ((1u << bits) < n)
+        ++bits;
+    bitrev.resize(n);
+    for (unsigned i = 0; i < n; ++i)
+    {
+        unsigned r = 0;
+        for (unsigned b = 0; b < bits; ++b)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        bitrev[i] = r;
+    }
+
+    std::mt19937 rng(1337);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    float L = windSpeed * windSpeed / GRAVITY;
+    float damp = L / 1000.0f;
+    for (unsigned z = 0; z < n; ++z)
+    {
+        for (unsigned x = 0; x < n; ++x)
+        {
+            float xr = gauss(rng), xi = gauss(rng);
+            float kx = 2 * (float) M_PI * ((int) x - (x < n / 2 ? 0 : (int) n)) / patchLength;
+            float kz = 2 * (float) M_PI * ((int) z - (z < n / 2 ? 0 : (int) n)) / patchLength;
+            float k2 = kx * kx + kz * kz;
+            if (k2 == 0 || x == n / 2 || z == n / 2)
+                continue;
+
+            float kw = (kx * windX + kz * windZ);
+            float P = amplitude * expf(-1.0f / (k2 * L * L)) / (k2 * k2) * (kw * kw / k2) * expf(-k2 * damp * damp);
+            float s = sqrtf(P * 0.5f);
+            h0[z * n + x] = Complex(xr * s, xi * s);
+            omega[z * n + x] = sqrtf(GRAVITY * sqrtf(k2));
+        }
+    }
+
+    dirty = false;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// h(k, t) = h0(k) e^(i w t) + conj(h0(-k)) e^(-i w t), written as H - kx H
+// (height + i slope x) and i kz H. h(-k, t) = conj(h(k, t)), so row kz also
+// fills its mirror row -kz and only half the spectrum needs sin/cos; begin
+// and end are rows of [0, N/2].
+///////////////////////////////////////////////////////////////////////////////
+void Ocean::fillSpectrum(float time, unsigned begin, unsigned end)
+{
+    unsigned n = size;
+    unsigned mask = n - 1;
+    float dk = 2 * (float) M_PI / patchLength;
+    for (unsigned z = begin; z < end; ++z)
+    {
+        unsigned mz = (n - z) & mask;
+        float kz = dk * ((int) z - (z < n / 2 ? 0 : (int) n));
+        float mkz = dk * ((int) mz - (mz < n / 2 ? 0 : (int) n));
+        for (unsigned x = 0; x < n; ++x)
+        {
+            unsigned mx = (n - x) & mask;
+            if (mz == z && mx < x)
+                continue;                   // self-mirrored row, done from the other half
+
+            unsigned idx = z * n + x;
+            unsigned midx = mz * n + mx;
+            float kx = dk * ((int) x - (x < n / 2 ? 0 : (int) n));
+            float mkx = dk * ((int) mx - (mx < n / 2 ? 0 : (int) n));
+            float c, s;
+            trigSinCos(omega[idx] * time, &s, &c);
+            Complex h = mul(h0[idx], Complex(c, s)) + mul(std::conj(h0[midx]), Complex(c, -s));
+            Complex m = std::conj(h);
+
+            heightSlopeX[idx] = h * (1 - kx);
+            slopeZ[idx] = Complex(-kz * h.imag(), kz * h.real());
+            heightSlopeX[midx] = m * (1 - mkx);
+            slopeZ[midx] = Complex(-mkz * m.imag(), mkz * m.real());
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// in-place radix-2 inverse FFT (no 1/N scaling) of rows [begin, end)
+///////////////////////////////////////////////////////////////////////////////
+void Ocean::fftRows(Complex *data, unsigned begin, unsigned end) const
+{
+    unsigned n = size;
+    for (unsigned row = begin; row < end; ++row)
+    {
+        Complex *a = data + row * n;
+        for (unsigned i = 0; i < n; ++i)
+            if (i < bitrev[i])
+                std::swap(a[i], a[bitrev[i]]);
+
+        // first stage has the twiddle 1 only
+        for (unsigned s = 0; s < n; s += 2)
+        {
+            Complex u = a[s];
+            Complex v = a[s + 1];
+            a[s] = u + v;
+            a[s + 1] = u - v;
+        }
+
+        for (unsigned half = 2; half < n; half <<= 1)
+        {
+            const Complex *w = &twiddle[half - 1];
+            for (unsigned s = 0; s < n; s += 2 * half)
+            {
+                Complex *lo = a + s;
+                Complex *hi = a + s + half;
+                for (unsigned k = 0; k < half; ++k)
+                {
+                    Complex u = lo[k];
+                    Complex v = mul(hi[k], w[k]);
+                    lo[k] = u + v;
+                    hi[k] = u - v;
+                }
+            }
+        }
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// dst[x][z] = src[z][x] for output rows x in [begin, end), in tiles so both
+// sides stay within a few cache lines
+///////////////////////////////////////////////////////////////////////////////
+void Ocean::transpose(const Complex *src, Complex *dst, unsigned begin, unsigned end) const
+{
+    unsigned n = size;
+    for (unsigned z0 = 0; z0 < n; z0 += TRANSPOSE_TILE)
+    {
+        unsigned z1 = z0 + TRANSPOSE_TILE < n ? z0 + TRANSPOSE_TILE : n;
+        for (unsigned x = begin; x < end; ++x)
+            for (unsigned z = z0; z < z1; ++z)
+                dst[x * n + z] = src[z * n + x];
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// height and normal of grid vertices [begin, end), the patch repeats every
+// N vertices. One patch sample maps to one grid step, so metres scale by
+// dx * N / patchLength horizontally; heights use 2 / patchLength so the
+// patch fills the [-1, 1] grid at N = cols.
+///////////////////////////////////////////////////////////////////////////////
+void Ocean::storeVertices(Vertex *dst, const WaveGrid *grid, unsigned begin, unsigned end) const
+{
+    unsigned n = size;
+    unsigned mask = n - 1;
+    unsigned rowCount = grid->rows + 1;
+    float heightScale = 2.0f / patchLength;
+    float scaleX = heightScale * patchLength / (grid->dx * n);
+    float scaleZ = heightScale * patchLength / (grid->dz * n);
+
+    unsigned i = begin / rowCount;
+    unsigned j = begin % rowCount;
+    for (unsigned idx = begin; idx < end; ++idx)
+    {
+        unsigned s = (i & mask) * n + (j & mask);
+        Complex hs = heightSlopeXT[s];
+        float sz = slopeZT[s].real();
+
+        dst[idx].r.y = hs.real() * heightScale;
+        dst[idx].n = glm::normalize(glm::vec3(-hs.imag() * scaleX, 1.0f, -sz * scaleZ));
+
+        if (++j == rowCount)
+        {
+            j = 0;
+            ++i;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef TOWERDEFENSESDL_OCEAN_H
+#define TOWERDEFENSESDL_OCEAN_H
+
+#include <complex>
+#include <vector>
+#include "ThreadPool.h"
+#include "gridAlloc.h"
+#include "waveKernel.h"
+
+// Tessendorf ocean on the CPU. Height and slopes come from a Phillips
+// spectrum through an inverse 2D FFT, so a frame costs O(N^2 log N) however
+// many wave components the spectrum holds (N^2 of them). The N x N patch,
+// N a power of two, is periodic and tiled over the vertex grid.
+class Ocean
+{
+public:
+    Ocean();                                    // default constructor, empty spectrum
+
+    void     setSize(unsigned n);               // FFT size, rounded up to a power of two
+    unsigned getSize() const;
+    void     setWind(float speed, float dirX, float dirZ);     // m/s and direction on the xz plane
+    void     setPatchLength(float meters);      // size of the periodic patch
+
+    // write r.y and n of the grid vertices in dst for the given time,
+    // spectrum, transforms and vertex pass all split over pool
+    void     update(Vertex *dst, const WaveGrid *grid, float time, ThreadPool &pool);
+
+    double   getFFTTimeInMilliSec() const;      // spectrum + transforms of the last update
+
+
+private:
+    typedef std::complex<float> Complex;
+    typedef std::vector<Complex, GridAllocator<Complex> > Field;     // N x N, huge pages when large
+
+    void     buildSpectrum();                                           // h0(k) for the current settings
+    void     fillSpectrum(float time, unsigned begin, unsigned end);    // h(k, t) of rows [begin, end)
+    void     fftRows(Complex *data, unsigned begin, unsigned end) const;
+    void     transpose(const Complex *src, Complex *dst, unsigned begin, unsigned end) const;
+    void     storeVertices(Vertex *dst, const WaveGrid *grid, unsigned begin, unsigned end) const;
+
+    unsigned size;                              // N
+    float    windSpeed, windX, windZ;
+    float    patchLength;                       // metres covered by the N x N patch
+    float    amplitude;                         // Phillips constant
+    bool     dirty;                             // h0 needs rebuilding
+    std::vector<Complex> h0;                    // initial amplitudes, [kz][kx]
+    std::vector<float> omega;                   // dispersion sqrt(g |k|), [kz][kx]
+    std::vector<Complex> twiddle;               // e^(i pi k / half) per radix-2 stage
+    std::vector<unsigned> bitrev;               // bit reversed index for the radix-2 passes
+    Field    heightSlopeX;                      // h + i dh/dx, spectrum [kz][kx]
+    Field    slopeZ;                            // dh/dz (real part only), spectrum [kz][kx]
+    Field    heightSlopeXT;                     // the same after the row pass, transposed to [x][kz]
+    Field    slopeZT;
+    double   fftTime;
+};
+
+#endif //TOWERDEFENSESDL_OCEAN_H
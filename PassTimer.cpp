@@ -0,0 +1,125 @@
+#define GLEW_STATIC
+
+#include <GL/glew.h>
+#include "PassTimer.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+PassTimer::PassTimer()
+        : frame(0), created(false), active(false), count(0)
+{
+    for (unsigned f = 0; f < FRAMES; ++f)
+    {
+        used[f] = 0;
+        for (unsigned p = 0; p < MAX_PASSES; ++p)
+            queries[f][p] = 0;
+    }
+    for (unsigned p = 0; p < MAX_PASSES; ++p)
+        times[p] = 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// destructor. Runs after the GL context is gone, the driver frees the rest.
+///////////////////////////////////////////////////////////////////////////////
+PassTimer::~PassTimer()
+{
+}
+
+
+
+bool PassTimer::isSupported()
+{
+    return GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+}
+
+
+
+void PassTimer::beginFrame()
+{
+    if (!created)
+    {
+        glGenQueries(FRAMES * MAX_PASSES, &queries[0][0]);
+        created = true;
+    }
+
+    frame = (frame + 1) % FRAMES;
+    unsigned n = used[frame];
+    used[frame] = 0;
+    if (!n)
+        return;
+
+    // the passes finish in order, the last one being done means all are
+    GLint available = 0;
+    glGetQueryObjectiv(queries[frame][n - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+
+    for (unsigned p = 0; p < n; ++p)
+    {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[frame][p], GL_QUERY_RESULT, &ns);
+        times[p] = ns / 1e6;
+    }
+    count = n;
+}
+
+
+
+void PassTimer::begin()
+{
+    if (!created || used[frame] >= MAX_PASSES)
+        return;
+    glBeginQuery(GL_TIME_ELAPSED, queries[frame][used[frame]]);
+    active = true;
+}
+
+
+
+void PassTimer::end()
+{
+    if (!active)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    active = false;
+    ++used[frame];
+}
+
+
+
+void PassTimer::release()
+{
+    if (created)
+        glDeleteQueries(FRAMES * MAX_PASSES, &queries[0][0]);
+    created = false;
+    for (unsigned f = 0; f < FRAMES; ++f)
+        used[f] = 0;
+    count = 0;
+}
+
+
+
+unsigned PassTimer::getPassCount() const
+{
+    return count;
+}
+
+
+
+double PassTimer::getPassTimeInMilliSec(unsigned pass) const
+{
+    return pass < count ? times[pass] : 0;
+}
+
+
+
+double PassTimer::getTotalTimeInMilliSec() const
+{
+    double total = 0;
+    for (unsigned p = 0; p < count; ++p)
+        total += times[p];
+    return total;
+}
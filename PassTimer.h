@@ -0,0 +1,46 @@
+#ifndef TOWERDEFENSESDL_PASSTIMER_H
+#define TOWERDEFENSESDL_PASSTIMER_H
+
+#include <stddef.h>
+
+/*
+ * GPU time of each pass of a frame from GL_TIME_ELAPSED queries (GL 3.3 or
+ * ARB_timer_query).
+ *
+ * A query's result arrives after the GPU has run the pass, and asking for
+ * it earlier would wait. So every frame takes its queries from a ring of
+ * FRAMES sets, and beginFrame() reads back the set it is about to reuse
+ * only if the GPU is done with it; the times shown lag a couple of frames,
+ * and a frame the GPU is still busy with is skipped rather than waited for.
+ */
+class PassTimer
+{
+public:
+    static const unsigned FRAMES = 3;
+    static const unsigned MAX_PASSES = 8;
+
+    PassTimer();                                // default constructor, no queries
+    ~PassTimer();                               // nothing, call release() while GL is up
+
+    static bool isSupported();                  // needs a GL context and glewInit()
+
+    void     beginFrame();                      // read back the oldest frame, start a new one
+    void     begin();                           // the frame's next pass; passes past MAX_PASSES go untimed
+    void     end();
+    void     release();
+
+    unsigned getPassCount() const;              // of the last frame read back
+    double   getPassTimeInMilliSec(unsigned pass) const;
+    double   getTotalTimeInMilliSec() const;
+
+
+private:
+    unsigned queries[FRAMES][MAX_PASSES];
+    unsigned used[FRAMES];                      // passes begun in each frame
+    unsigned frame;
+    bool     created, active;
+    unsigned count;
+    double   times[MAX_PASSES];
+};
+
+#endif //TOWERDEFENSESDL_PASSTIMER_H
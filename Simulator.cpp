@@ -0,0 +1,175 @@
+#include "Simulator.h"
+#include "Timer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+Simulator::Simulator()
+        : middle(1), back(2), front(0), requested(0), requestTime(0), quit(false),
+          stepTime(0), idleTime(0), dropped(0)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// destructor
+///////////////////////////////////////////////////////////////////////////////
+Simulator::~Simulator()
+{
+    stop();
+}
+
+
+
+void Simulator::start(const Vertex *initial, unsigned count, const Step &step, float time)
+{
+    stop();
+
+    for (std::vector<Vertex> &buffer : buffers)
+        buffer.assign(initial, initial + count);
+    for (std::vector<double> &times : threadTimes)
+        times.clear();
+    front = 0;
+    middle.store(1);
+    back = 2;
+    this->step = step;
+
+    // the first frame is computed here so acquire() never returns a flat grid
+    Timer t;
+    t.start();
+    step(buffers[front].data(), time, &threadTimes[front]);
+    t.stop();
+    stepTime = (float) t.getElapsedTimeInMilliSec();
+    idleTime = 0;
+    dropped = 0;
+
+    quit = false;
+    requested = 0;
+    thread = std::thread(&Simulator::threadLoop, this);
+}
+
+
+
+void Simulator::stop()
+{
+    if (!thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+
+
+bool Simulator::isRunning() const
+{
+    return thread.joinable();
+}
+
+
+
+void Simulator::request(float time)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requestTime = time;
+        ++requested;
+    }
+    wake.notify_one();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// take the middle buffer if the simulation has published a frame since the
+// last call, otherwise keep showing the current front buffer
+///////////////////////////////////////////////////////////////////////////////
+const Vertex *Simulator::acquire()
+{
+    if (middle.load(std::memory_order_acquire) & FRESH)
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+    return buffers[front].data();
+}
+
+
+
+double Simulator::getStepTimeInMilliSec() const
+{
+    return stepTime;
+}
+
+
+
+double Simulator::getIdleTimeInMilliSec() const
+{
+    return idleTime;
+}
+
+
+
+unsigned Simulator::getDroppedFrames() const
+{
+    return dropped;
+}
+
+
+
+double Simulator::getThreadTimeInMilliSec(unsigned thread) const
+{
+    const std::vector<double> &times = threadTimes[front];
+    return thread < times.size() ? times[thread] : 0.0;
+}
+
+
+
+double Simulator::getMaxThreadTimeInMilliSec() const
+{
+    double max = 0.0;
+    for (double t : threadTimes[front])
+        if (t > max)
+            max = t;
+    return max;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// wait for a request, compute it into the back buffer, publish it as the
+// fresh middle buffer. A frame still fresh when the next one is published
+// was never shown and counts as dropped.
+///////////////////////////////////////////////////////////////////////////////
+void Simulator::threadLoop()
+{
+    unsigned seen = 0;
+    Timer idle, busy;
+    while (true)
+    {
+        float time;
+        idle.start();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, &seen] { return quit || requested != seen; });
+            if (quit)
+                return;
+            seen = requested;
+            time = requestTime;
+        }
+        idle.stop();
+        idleTime = (float) idle.getElapsedTimeInMilliSec();
+
+        busy.start();
+        step(buffers[back].data(), time, &threadTimes[back]);
+        busy.stop();
+        stepTime = (float) busy.getElapsedTimeInMilliSec();
+
+        unsigned previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        if (previous & FRESH)
+            ++dropped;
+        back = previous & INDEX;
+    }
+}
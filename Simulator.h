@@ -0,0 +1,69 @@
+#ifndef TOWERDEFENSESDL_SIMULATOR_H
+#define TOWERDEFENSESDL_SIMULATOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "wave.h"
+
+// Runs the vertex update on a thread of its own so the next frame is
+// computed while the current one is drawn. Frames are handed over through
+// a lock-free triple buffer: the simulation thread fills the back buffer and
+// swaps it with the middle one, acquire() swaps a fresh middle buffer to the
+// front. Neither side waits for the other; the mutex only parks the
+// simulation thread until the next request(). The step also reports the
+// time of each of its threads; those travel with the frame's buffer, so
+// the caller of acquire() reads them without racing the next step.
+class Simulator
+{
+public:
+    typedef std::function<void(Vertex *dst, float time, std::vector<double> *threadTimes)> Step;
+
+    Simulator();                                // default constructor, not running
+    ~Simulator();                               // stops the thread
+
+    // copy initial into every buffer, compute the frame at time on the
+    // calling thread, then start the simulation thread
+    void     start(const Vertex *initial, unsigned count, const Step &step, float time);
+    void     stop();
+    bool     isRunning() const;
+
+    void     request(float time);               // compute the frame at time, returns at once
+    const Vertex *acquire();                    // newest finished frame, valid until the next acquire()
+
+    double   getStepTimeInMilliSec() const;     // last step on the simulation thread
+    double   getIdleTimeInMilliSec() const;     // time the thread waited for its last request
+    unsigned getDroppedFrames() const;          // frames finished but never acquired
+    double   getThreadTimeInMilliSec(unsigned thread) const;   // per thread of the acquired frame
+    double   getMaxThreadTimeInMilliSec() const;
+
+
+private:
+    void     threadLoop();
+
+    static const unsigned FRESH = 4;            // set in middle when it holds an unseen frame
+    static const unsigned INDEX = 3;
+
+    std::vector<Vertex> buffers[3];
+    std::vector<double> threadTimes[3];         // milli-seconds per thread, one per buffer
+    std::atomic<unsigned> middle;               // buffer index | FRESH
+    unsigned back;                              // owned by the simulation thread
+    unsigned front;                             // owned by the caller of acquire()
+    Step     step;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;               // signalled by request() and stop()
+    unsigned requested;                         // request generation, guarded by mutex
+    float    requestTime;                       // guarded by mutex
+    bool     quit;                              // guarded by mutex
+
+    std::atomic<float> stepTime;
+    std::atomic<float> idleTime;
+    std::atomic<unsigned> dropped;
+};
+
+#endif //TOWERDEFENSESDL_SIMULATOR_H
@@ -0,0 +1,203 @@
+#define GLEW_STATIC
+
+#include <GL/glew.h>
+#include <cstring>
+#include "StreamRing.h"
+#include "Timer.h"
+
+// segments start on this boundary, enough for any vertex attribute
+static const size_t SEGMENT_ALIGN = 256;
+
+static const GLbitfield RING_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+StreamRing::StreamRing()
+        : buffer(0), mapped(NULL), segmentBytes(0), current(0), stalls(0), waitTime(0), totalWaitTime(0)
+{
+    for (unsigned i = 0; i < SEGMENTS; ++i)
+        fences[i] = NULL;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// destructor. Runs after the GL context is gone, the driver frees the rest.
+///////////////////////////////////////////////////////////////////////////////
+StreamRing::~StreamRing()
+{
+}
+
+
+
+bool StreamRing::isSupported()
+{
+    return GLEW_VERSION_4_4 || (GLEW_ARB_buffer_storage && GLEW_ARB_sync);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// buffer storage is immutable, so a larger ring is a new buffer; a smaller
+// one reuses the segments it has
+///////////////////////////////////////////////////////////////////////////////
+bool StreamRing::create(size_t bytes, const void *initial)
+{
+    for (unsigned i = 0; i < SEGMENTS; ++i)
+        waitFence(i);
+
+    size_t needed = (bytes + SEGMENT_ALIGN - 1) / SEGMENT_ALIGN * SEGMENT_ALIGN;
+    if (!buffer || needed > segmentBytes)
+    {
+        release();
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferStorage(GL_ARRAY_BUFFER, needed * SEGMENTS, NULL, RING_FLAGS);
+        mapped = (char *) glMapBufferRange(GL_ARRAY_BUFFER, 0, needed * SEGMENTS, RING_FLAGS);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (!mapped)
+        {
+            release();
+            return false;
+        }
+        segmentBytes = needed;
+    }
+
+    // update paths that write part of a vertex rely on the rest being there
+    for (unsigned i = 0; i < SEGMENTS; ++i)
+        memcpy(mapped + i * segmentBytes, initial, bytes);
+    current = 0;
+    return true;
+}
+
+
+
+void StreamRing::release()
+{
+    for (unsigned i = 0; i < SEGMENTS; ++i)
+    {
+        if (fences[i])
+            glDeleteSync((GLsync) fences[i]);
+        fences[i] = NULL;
+    }
+    // deleting a mapped buffer unmaps it; nothing to do (and maybe no GL
+    // yet) without one
+    if (buffer)
+        glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    mapped = NULL;
+    segmentBytes = 0;
+}
+
+
+
+bool StreamRing::isCreated() const
+{
+    return mapped != NULL;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// wait until the GPU has finished the draws fenced on segment. The first
+// poll does not wait; if the fence is still pending the frame stalls, which
+// is counted, and the wait flushes so the fence is sure to be reached.
+///////////////////////////////////////////////////////////////////////////////
+void StreamRing::waitFence(unsigned segment)
+{
+    GLsync fence = (GLsync) fences[segment];
+    if (!fence)
+        return;
+
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        Timer timer;
+        timer.start();
+        ++stalls;
+        do {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);     // 1 ms
+        } while (result == GL_TIMEOUT_EXPIRED);
+        timer.stop();
+        waitTime += timer.getElapsedTimeInMilliSec();
+    }
+    glDeleteSync(fence);
+    fences[segment] = NULL;
+}
+
+
+
+void *StreamRing::begin()
+{
+    if (!mapped)
+        return NULL;
+
+    current = (current + 1) % SEGMENTS;
+    waitTime = 0;
+    waitFence(current);
+    totalWaitTime += waitTime;
+    return mapped + current * segmentBytes;
+}
+
+
+
+void StreamRing::end()
+{
+    if (!mapped)
+        return;
+    if (fences[current])
+        glDeleteSync((GLsync) fences[current]);
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+
+
+unsigned StreamRing::getBuffer() const
+{
+    return buffer;
+}
+
+
+
+size_t StreamRing::getOffset() const
+{
+    return current * segmentBytes;
+}
+
+
+
+size_t StreamRing::getBytes() const
+{
+    return segmentBytes * SEGMENTS;
+}
+
+
+
+unsigned StreamRing::getStalls() const
+{
+    return stalls;
+}
+
+
+
+double StreamRing::getWaitTimeInMilliSec() const
+{
+    return waitTime;
+}
+
+
+
+double StreamRing::getTotalWaitTimeInMilliSec() const
+{
+    return totalWaitTime;
+}
+
+
+
+void StreamRing::resetStats()
+{
+    stalls = 0;
+    waitTime = totalWaitTime = 0;
+}
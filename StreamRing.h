@@ -0,0 +1,60 @@
+#ifndef TOWERDEFENSESDL_STREAMRING_H
+#define TOWERDEFENSESDL_STREAMRING_H
+
+#include <stddef.h>
+
+/*
+ * Vertex stream through a persistently mapped buffer (GL 4.4 or
+ * ARB_buffer_storage with ARB_sync).
+ *
+ * glMapBuffer() on the VBO has to wait whenever the GPU still reads the
+ * frame before. The ring instead keeps SEGMENTS copies of the vertex data
+ * in one immutable buffer that stays mapped (persistent and coherent, so no
+ * unmap or flush). Each frame writes the next segment and draws from it;
+ * a fence after the draw tells when the GPU is done with the segment, and
+ * begin() waits on it only when the CPU has come round the ring before the
+ * GPU caught up. Those waits are counted and timed.
+ */
+class StreamRing
+{
+public:
+    static const unsigned SEGMENTS = 3;
+
+    StreamRing();                               // default constructor, no buffer
+    ~StreamRing();                              // nothing, call release() while GL is up
+
+    static bool isSupported();                  // needs a GL context and glewInit()
+
+    // a ring of segments of at least bytes, every segment starting as a
+    // copy of initial; waits for the GPU to let go of the old ring first
+    bool     create(size_t bytes, const void *initial);
+    void     release();
+    bool     isCreated() const;
+
+    void    *begin();                           // wait for the next segment, return its mapping
+    void     end();                             // fence the segment after the draws from it
+
+    unsigned getBuffer() const;
+    size_t   getOffset() const;                 // of the segment of the current frame
+    size_t   getBytes() const;                  // of the whole buffer
+
+    unsigned getStalls() const;                 // begin() calls that had to wait
+    double   getWaitTimeInMilliSec() const;     // of the last begin()
+    double   getTotalWaitTimeInMilliSec() const;
+    void     resetStats();
+
+
+private:
+    void     waitFence(unsigned segment);
+
+    unsigned buffer;
+    char    *mapped;
+    size_t   segmentBytes;
+    void    *fences[SEGMENTS];                  // GLsync, NULL once waited for
+    unsigned current;
+    unsigned stalls;
+    double   waitTime;
+    double   totalWaitTime;
+};
+
+#endif //TOWERDEFENSESDL_STREAMRING_H
@@ -0,0 +1,174 @@
+#include "ThreadPool.h"
+#include "Timer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+ThreadPool::ThreadPool()
+        : job(nullptr), count(0), bandSize(0), generation(0), pending(0), quit(false), threadTime(1, 0.0)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// destructor
+///////////////////////////////////////////////////////////////////////////////
+ThreadPool::~ThreadPool()
+{
+    stopWorkers();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// (re)create the workers. threads is the total number of threads including
+// the caller of run(), so 1 means no worker threads at all.
+///////////////////////////////////////////////////////////////////////////////
+void ThreadPool::setThreadCount(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    if (threads == getThreadCount())
+        return;
+
+    stopWorkers();
+
+    quit = false;
+    threadTime.assign(threads, 0.0);
+    for (unsigned i = 1; i < threads; ++i)
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, i, generation));
+}
+
+
+
+unsigned ThreadPool::getThreadCount() const
+{
+    return (unsigned) workers.size() + 1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// split [0, count) into bands and run them on all threads.
+// Bands are rounded up to a multiple of align items so that neighbouring
+// threads never write into the same cache line.
+///////////////////////////////////////////////////////////////////////////////
+void ThreadPool::run(unsigned count, unsigned align, const Job &job)
+{
+    unsigned threads = getThreadCount();
+    if (align == 0)
+        align = 1;
+
+    unsigned band = (count + threads - 1) / threads;
+    band = (band + align - 1) / align * align;
+
+    if (threads == 1 || count <= align)
+    {
+        Timer t;
+        t.start();
+        job(0, count);
+        t.stop();
+        threadTime.assign(threads, 0.0);
+        threadTime[0] = t.getElapsedTimeInMilliSec();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->job = &job;
+        this->count = count;
+        this->bandSize = band;
+        pending = (unsigned) workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    runBand(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+    this->job = nullptr;
+}
+
+
+
+double ThreadPool::getThreadTimeInMilliSec(unsigned thread) const
+{
+    return thread < threadTime.size() ? threadTime[thread] : 0.0;
+}
+
+
+
+double ThreadPool::getMaxThreadTimeInMilliSec() const
+{
+    double max = 0.0;
+    for (double t : threadTime)
+        if (t > max)
+            max = t;
+    return max;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// process the band of thread index, empty bands only record zero time
+///////////////////////////////////////////////////////////////////////////////
+void ThreadPool::runBand(unsigned index)
+{
+    unsigned begin = index * bandSize;
+    unsigned end = begin + bandSize < count ? begin + bandSize : count;
+
+    if (begin >= end)
+    {
+        threadTime[index] = 0.0;
+        return;
+    }
+
+    Timer t;
+    t.start();
+    (*job)(begin, end);
+    t.stop();
+    threadTime[index] = t.getElapsedTimeInMilliSec();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// wait for a job newer than the last one seen, run our band, report back
+///////////////////////////////////////////////////////////////////////////////
+void ThreadPool::workerLoop(unsigned index, unsigned seen)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this, &seen] { return quit || generation != seen; });
+        if (quit)
+            return;
+        seen = generation;
+
+        lock.unlock();
+        runBand(index);
+        lock.lock();
+
+        if (--pending == 0)
+            done.notify_one();
+    }
+}
+
+
+
+void ThreadPool::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+
+    for (std::thread &worker : workers)
+        worker.join();
+    workers.clear();
+}
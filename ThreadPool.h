@@ -0,0 +1,50 @@
+#ifndef TOWERDEFENSESDL_THREADPOOL_H
+#define TOWERDEFENSESDL_THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads for splitting per-frame work into bands.
+// The threads are created once by setThreadCount() and sleep between jobs;
+// the calling thread always processes band 0 itself.
+class ThreadPool
+{
+public:
+    typedef std::function<void(unsigned begin, unsigned end)> Job;
+
+    ThreadPool();                               // default constructor, no workers
+    ~ThreadPool();                              // joins the workers
+
+    void     setThreadCount(unsigned threads);  // total threads incl. caller, 0: one per core
+    unsigned getThreadCount() const;            // total threads incl. caller
+
+    // run job over [0, count) split into one band per thread, each band
+    // a multiple of align items; blocks until every band is done
+    void     run(unsigned count, unsigned align, const Job &job);
+
+    double   getThreadTimeInMilliSec(unsigned thread) const;   // time of the thread's last band
+    double   getMaxThreadTimeInMilliSec() const;
+
+
+private:
+    void     workerLoop(unsigned index, unsigned seen);
+    void     runBand(unsigned index);
+    void     stopWorkers();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;               // signalled when a job is posted
+    std::condition_variable done;               // signalled when the last worker finishes
+    const Job *job;                             // job being run, valid during run()
+    unsigned count;                             // items of the current job
+    unsigned bandSize;                          // items per band of the current job
+    unsigned generation;                        // incremented for every job
+    unsigned pending;                           // workers still busy with the job
+    bool     quit;
+    std::vector<double> threadTime;             // milli-seconds per thread
+};
+
+#endif //TOWERDEFENSESDL_THREADPOOL_H
@@ -0,0 +1,241 @@
+#define GLEW_STATIC
+
+#include <GL/glew.h>
+#include "TiledGrid.h"
+#include "gridIndex.h"
+#include "Timer.h"
+
+#define BUFFER_OFFSET(i) ((void*)(i))
+
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+TiledGrid::TiledGrid()
+        : rows(0), cols(0), tilesX(0), tilesZ(0), ibo(0), indexCount(0), indexCacheSize(0), buildTime(0)
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// destructor. Runs after the GL context is gone, so the buffer objects are
+// left to the driver; release() frees them while GL is still up.
+///////////////////////////////////////////////////////////////////////////////
+TiledGrid::~TiledGrid()
+{
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// cut rows x cols into tiles. Every tile has the same size, so the buffers
+// of the previous grid are reused as they are; only the tiles beyond the
+// new count get or lose one. The waves are evaluated by update(), so a new
+// grid shows the same model as every frame.
+///////////////////////////////////////////////////////////////////////////////
+bool TiledGrid::build(unsigned rows, unsigned cols, const sinewave *waves, unsigned nWaves, double time,
+                      unsigned cacheSize, ThreadPool &pool)
+{
+    Timer timer;
+    timer.start();
+
+    unsigned nx = (unsigned) (((uint64_t) cols + TILE_QUADS - 1) / TILE_QUADS);
+    unsigned nz = (unsigned) (((uint64_t) rows + TILE_QUADS - 1) / TILE_QUADS);
+    size_t count = (size_t) nx * nz;
+
+    for (size_t i = count; i < tiles.size(); ++i)
+        glDeleteBuffers(1, &tiles[i].vbo);
+    size_t reused = tiles.size() < count ? tiles.size() : count;
+    Tile empty = {{0, 0, 0, 0, 0, 0}, 0};
+    tiles.resize(count, empty);
+
+    this->rows = rows;
+    this->cols = cols;
+    tilesX = nx;
+    tilesZ = nz;
+    for (size_t t = 0; t < count; ++t)
+        placeTile(tiles[t], (unsigned) (t % nx), (unsigned) (t / nx));
+
+    // storage for the new tiles; update() fills every buffer
+    bool failed = false;
+    for (size_t t = reused; t < count && !failed; ++t)
+    {
+        if (!tiles[t].vbo)
+            glGenBuffers(1, &tiles[t].vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, tiles[t].vbo);
+        glBufferData(GL_ARRAY_BUFFER, TILE_VERTICES * sizeof(Vertex), NULL, GL_DYNAMIC_DRAW);
+        failed = glGetError() == GL_OUT_OF_MEMORY;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (failed)
+    {
+        release();
+        return false;
+    }
+    update(waves, nWaves, (float) time, pool);
+
+    if (!ibo || cacheSize != indexCacheSize)
+        buildIndices(cacheSize);
+
+    timer.stop();
+    buildTime = timer.getElapsedTimeInMilliSec();
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// where tile (tx, tz) lies in the grid; the update derives its vertices
+// from that
+///////////////////////////////////////////////////////////////////////////////
+void TiledGrid::placeTile(Tile &tile, unsigned tx, unsigned tz) const
+{
+    unsigned i0 = tx * TILE_QUADS;
+    unsigned j0 = tz * TILE_QUADS;
+    unsigned lastI = cols - i0 < TILE_QUADS ? cols - i0 : TILE_QUADS;
+    unsigned lastJ = rows - j0 < TILE_QUADS ? rows - j0 : TILE_QUADS;
+    tile.place = {i0, j0, TILE_QUADS, TILE_QUADS, lastI, lastJ};
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// the index buffer every tile is drawn with: the blocked triangle list of
+// one tile, which fits 16 bits since a tile has 65536 vertices
+///////////////////////////////////////////////////////////////////////////////
+void TiledGrid::buildIndices(unsigned cacheSize)
+{
+    std::vector<unsigned> list;
+    blockedGridTriangles(list, TILE_QUADS, TILE_QUADS, cacheSize);
+
+    std::vector<unsigned short> shortList(list.begin(), list.end());
+    indexCount = (unsigned) shortList.size();
+    indexCacheSize = cacheSize;
+
+    if (!ibo)
+        glGenBuffers(1, &ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortList.size() * sizeof(unsigned short), shortList.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+
+
+void TiledGrid::release()
+{
+    for (size_t i = 0; i < tiles.size(); ++i)
+        glDeleteBuffers(1, &tiles[i].vbo);
+    tiles.clear();
+    glDeleteBuffers(1, &ibo);
+    ibo = 0;
+    indexCount = 0;
+    rows = cols = tilesX = tilesZ = 0;
+}
+
+
+
+bool TiledGrid::matches(unsigned rows, unsigned cols) const
+{
+    return !tiles.empty() && this->rows == rows && this->cols == cols;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// map, update and unmap one tile after the other. The separable tables are
+// built once for the whole grid and every tile reads its columns and rows
+// out of them; the recurrence keeps one phasor per vertex of a single
+// array, so the tiles evaluate directly instead. The buffers are mapped
+// write-only with their old contents invalidated; the kernel writes every
+// field of every vertex and reads nothing back.
+///////////////////////////////////////////////////////////////////////////////
+void TiledGrid::update(const sinewave *waves, unsigned nWaves, float time, ThreadPool &pool)
+{
+    WaveGrid whole = {rows, cols, -1.0f, -1.0f, 2 / (float) cols, 2 / (float) rows};
+    beginWaveTiles(waveEval, &whole, waves, nWaves, time);
+    bool mapRange = GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range;
+
+    for (size_t t = 0; t < tiles.size(); ++t)
+    {
+        const Tile &tile = tiles[t];
+        glBindBuffer(GL_ARRAY_BUFFER, tile.vbo);
+        auto *ptr = (Vertex *) (mapRange ? glMapBufferRange(GL_ARRAY_BUFFER, 0, TILE_VERTICES * sizeof(Vertex),
+                                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)
+                                         : glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
+        if (!ptr)
+            continue;
+
+        const WaveTile *place = &tile.place;
+        pool.run(TILE_VERTICES, VERTEX_BAND_ALIGN, [=](unsigned begin, unsigned end) {
+            updateWaveTileRange(ptr, place, begin, end);
+        });
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+
+void TiledGrid::draw() const
+{
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    for (size_t t = 0; t < tiles.size(); ++t)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, tiles[t].vbo);
+        glVertexPointer(3, GL_FLOAT, sizeof(Vertex), BUFFER_OFFSET(0));
+        glNormalPointer(GL_FLOAT, sizeof(Vertex), BUFFER_OFFSET(sizeof(vec3f)));
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, BUFFER_OFFSET(0));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+
+
+uint64_t TiledGrid::getVertexCount() const
+{
+    return tiles.empty() ? 0 : ((uint64_t) rows + 1) * ((uint64_t) cols + 1);
+}
+
+
+
+unsigned TiledGrid::getTileCount() const
+{
+    return (unsigned) tiles.size();
+}
+
+
+
+unsigned TiledGrid::getRows() const
+{
+    return rows;
+}
+
+
+
+unsigned TiledGrid::getCols() const
+{
+    return cols;
+}
+
+
+
+unsigned TiledGrid::getIndexCount() const
+{
+    return indexCount;
+}
+
+
+
+size_t TiledGrid::getBufferBytes() const
+{
+    return tiles.size() * TILE_VERTICES * sizeof(Vertex) + indexCount * sizeof(unsigned short);
+}
+
+
+
+double TiledGrid::getBuildTimeInMilliSec() const
+{
+    return buildTime;
+}
@@ -0,0 +1,77 @@
+#ifndef TOWERDEFENSESDL_TILEDGRID_H
+#define TOWERDEFENSESDL_TILEDGRID_H
+
+#include <stdint.h>
+#include <vector>
+#include "ThreadPool.h"
+#include "waveKernel.h"
+
+/*
+ * The grid cut into square tiles of TILE_QUADS x TILE_QUADS quads, for grids
+ * too large for the one-piece arrays (whose vertex and index counts are
+ * 32-bit and whose index buffer alone is 8 bytes per vertex).
+ *
+ * Every tile has (TILE_QUADS + 1)^2 vertices in a vertex buffer of its
+ * own, and no copy on the CPU; tiles share the edge vertices with their
+ * neighbours. All tiles have the same layout, so one 16-bit index buffer
+ * (a blocked triangle list, see blockedGridTriangles()) draws any of them.
+ * Tiles along the far edges would stick out of the grid; their extra
+ * vertices are clamped onto the edge, which turns the extra triangles into
+ * zero-area ones the rasterizer drops.
+ *
+ * The wave update, the upload and the draw all run tile by tile, so nothing
+ * scales with the size of the grid except the number of tiles and their
+ * buffers. The update lays out the rest positions from the tile's place
+ * in the grid and writes the vertices straight into the mapped buffer.
+ */
+class TiledGrid
+{
+public:
+    static const unsigned TILE_QUADS = 255;
+    static const unsigned TILE_VERTICES = (TILE_QUADS + 1) * (TILE_QUADS + 1);    // 65536, 16-bit indices
+
+    TiledGrid();                                // default constructor, no tiles
+    ~TiledGrid();                               // nothing, call release() while GL is up
+
+    // cut the rows x cols grid over [-1, 1]^2 into tiles and evaluate the
+    // waves at time into their buffers with update(); false if GL ran out
+    // of memory
+    bool     build(unsigned rows, unsigned cols, const sinewave *waves, unsigned nWaves, double time,
+                   unsigned cacheSize, ThreadPool &pool);
+    void     release();                         // free the tiles and every buffer object
+    bool     matches(unsigned rows, unsigned cols) const;   // built for this size
+
+    // per tile: map its buffer, evaluate the waves into it on pool, unmap.
+    // Follows waveEval and waveModel like the one-piece grid; the FFT ocean
+    // needs the whole grid and is not available here
+    void     update(const sinewave *waves, unsigned nWaves, float time, ThreadPool &pool);
+    void     draw() const;                      // one glDrawElements per tile, vertex/normal arrays enabled
+
+    uint64_t getVertexCount() const;            // of the grid, edge vertices shared by tiles counted once
+    unsigned getTileCount() const;
+    unsigned getRows() const;                   // size of the grid the tiles were built for
+    unsigned getCols() const;
+    unsigned getIndexCount() const;             // per tile
+    size_t   getBufferBytes() const;            // vertex buffers of all tiles plus the index buffer
+    double   getBuildTimeInMilliSec() const;
+
+
+private:
+    typedef struct {
+        WaveTile place;                         // where in the grid, source of the rest positions
+        unsigned vbo;
+    } Tile;
+
+    void     placeTile(Tile &tile, unsigned tx, unsigned tz) const;
+    void     buildIndices(unsigned cacheSize);
+
+    std::vector<Tile> tiles;
+    unsigned rows, cols;
+    unsigned tilesX, tilesZ;
+    unsigned ibo;                               // shared by every tile
+    unsigned indexCount;
+    unsigned indexCacheSize;                    // cache size the shared indices were ordered for
+    double   buildTime;
+};
+
+#endif //TOWERDEFENSESDL_TILEDGRID_H
@@ -0,0 +1,348 @@
+#define GLEW_STATIC
+
+#include <GL/glew.h>
+#include <cctype>
+#include <cstring>
+#include "Uploader.h"
+
+const double Uploader::STALL_MS = 0.25;
+
+static const char *const UPLOAD_STRING[nUpload] = {
+        "MAP_READ_WRITE", "MAP_INVALIDATE", "MAP_UNSYNCHRONIZED", "ORPHAN", "PERSISTENT"
+};
+
+
+const char *uploadStrategyName(UploadStrategy strategy)
+{
+    return strategy < nUpload ? UPLOAD_STRING[strategy] : "UNKNOWN";
+}
+
+bool parseUploadStrategy(const char *name, UploadStrategy *strategy)
+{
+    for (int i = 0; i < nUpload; ++i)
+    {
+        const char *a = name, *b = UPLOAD_STRING[i];
+        while (*a && tolower((unsigned char) *a) == tolower((unsigned char) *b))
+            ++a, ++b;
+        if (!*a && !*b)
+        {
+            *strategy = (UploadStrategy) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// constructor
+///////////////////////////////////////////////////////////////////////////////
+Uploader::Uploader()
+        : strategy(UPLOAD_MAP_READ_WRITE), buffer(0), capacity(0), bytes(0), uploadTime(0), uploadedBytes(0), stalls(0), stallTime(0)
+{
+}
+
+
+
+void Uploader::setStrategy(UploadStrategy strategy)
+{
+    if (strategy != UPLOAD_PERSISTENT)
+        ring.release();
+    this->strategy = strategy;
+    clearRecent();
+    resetStats();
+}
+
+
+
+UploadStrategy Uploader::getStrategy() const
+{
+    return strategy;
+}
+
+
+
+bool Uploader::isSupported(UploadStrategy strategy) const
+{
+    switch (strategy)
+    {
+        case UPLOAD_MAP_INVALIDATE:
+        case UPLOAD_MAP_UNSYNCHRONIZED:
+            return GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range;
+        case UPLOAD_PERSISTENT:
+            return StreamRing::isSupported();
+        default:
+            return true;
+    }
+}
+
+
+
+void Uploader::reset(unsigned buffer, size_t capacity, size_t bytes, const void *initial)
+{
+    this->buffer = buffer;
+    this->capacity = capacity;
+    this->bytes = bytes;
+    clearRecent();
+    if (strategy == UPLOAD_PERSISTENT && isSupported(strategy))
+        ring.create(bytes, initial);
+}
+
+
+
+void Uploader::release()
+{
+    ring.release();
+}
+
+
+
+bool Uploader::keepsContents() const
+{
+    return strategy == UPLOAD_MAP_READ_WRITE || strategy == UPLOAD_MAP_UNSYNCHRONIZED ||
+           (strategy == UPLOAD_PERSISTENT && ring.isCreated());
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// map this frame's vertices. An unsupported strategy falls back to
+// MAP_READ_WRITE, the way the VBO path always uploaded.
+///////////////////////////////////////////////////////////////////////////////
+void *Uploader::map()
+{
+    clock.start();
+    void *ptr = NULL;
+    switch (isSupported(strategy) ? strategy : UPLOAD_MAP_READ_WRITE)
+    {
+        case UPLOAD_MAP_INVALIDATE:
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            ptr = glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            break;
+        case UPLOAD_MAP_UNSYNCHRONIZED:
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            ptr = glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            break;
+        case UPLOAD_ORPHAN:
+            return NULL;
+        case UPLOAD_PERSISTENT:
+        {
+            unsigned before = ring.getStalls();
+            ptr = ring.begin();
+            if (ring.getStalls() != before)
+            {
+                ++stalls;
+                stallTime += ring.getWaitTimeInMilliSec();
+            }
+            return ptr;
+        }
+        default:
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            ptr = glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
+            break;
+    }
+    countStall(clock.getElapsedTimeInMilliSec());
+    return ptr;
+}
+
+
+
+void Uploader::unmap()
+{
+    if (strategy != UPLOAD_PERSISTENT || !ring.isCreated())
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    clock.stop();
+    uploadTime = clock.getElapsedTimeInMilliSec();
+    // the driver has to assume all of the mapping changed
+    uploadedBytes = bytes;
+}
+
+
+
+void Uploader::write(const void *data, size_t bytes)
+{
+    if (strategy == UPLOAD_ORPHAN)
+    {
+        clock.start();
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+        clock.stop();
+        uploadTime = clock.getElapsedTimeInMilliSec();
+        uploadedBytes = bytes;
+        countStall(uploadTime);
+        return;
+    }
+
+    void *ptr = map();
+    if (!ptr)
+        return;
+    memcpy(ptr, data, bytes);
+    unmap();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// upload the dirty ranges only. The map strategies map the span from the
+// first to the last range with explicit flushes, so the driver copies what
+// is flushed and not the gaps; invalidating is out, the gaps must survive.
+// The ring's next segment last saw the frame SEGMENTS-1 frames ago, so it
+// gets the ranges written since then as well.
+///////////////////////////////////////////////////////////////////////////////
+void Uploader::writeRanges(const void *data, size_t stride, const DirtyRanges &dirty)
+{
+    if (dirty.empty())
+    {
+        uploadTime = 0;
+        uploadedBytes = 0;
+        return;
+    }
+
+    const char *src = (const char *) data;
+    const std::vector<DirtyRanges::Range> &ranges = dirty.getRanges();
+    size_t written = 0;
+
+    if (strategy == UPLOAD_PERSISTENT && ring.isCreated())
+    {
+        DirtyRanges missed = dirty;
+        for (unsigned i = 0; i < StreamRing::SEGMENTS - 1; ++i)
+            missed.add(recent[i]);
+        for (unsigned i = StreamRing::SEGMENTS - 2; i > 0; --i)
+            recent[i] = recent[i - 1];
+        recent[0] = dirty;
+
+        char *dst = (char *) map();
+        const std::vector<DirtyRanges::Range> &all = missed.getRanges();
+        for (size_t i = 0; i < all.size(); ++i)
+        {
+            size_t offset = all[i].begin * stride, length = (all[i].end - all[i].begin) * stride;
+            memcpy(dst + offset, src + offset, length);
+            written += length;
+        }
+        unmap();
+        uploadedBytes = written;
+        return;
+    }
+
+    clock.start();
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    bool mapRange = strategy != UPLOAD_ORPHAN && (GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range);
+    char *dst = NULL;
+    size_t first = ranges.front().begin * stride;
+    if (mapRange)
+    {
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+        if (strategy == UPLOAD_MAP_UNSYNCHRONIZED)
+            access |= GL_MAP_UNSYNCHRONIZED_BIT;
+        dst = (char *) glMapBufferRange(GL_ARRAY_BUFFER, first, ranges.back().end * stride - first, access);
+        countStall(clock.getElapsedTimeInMilliSec());
+    }
+
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        size_t offset = ranges[i].begin * stride, length = (ranges[i].end - ranges[i].begin) * stride;
+        if (dst)
+        {
+            memcpy(dst + offset - first, src + offset, length);
+            glFlushMappedBufferRange(GL_ARRAY_BUFFER, offset - first, length);
+        }
+        else
+            glBufferSubData(GL_ARRAY_BUFFER, offset, length, src + offset);
+        written += length;
+    }
+    if (dst)
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+
+    clock.stop();
+    uploadTime = clock.getElapsedTimeInMilliSec();
+    uploadedBytes = written;
+    if (!mapRange)
+        countStall(uploadTime);
+}
+
+
+
+unsigned Uploader::getDrawBuffer() const
+{
+    return strategy == UPLOAD_PERSISTENT && ring.isCreated() ? ring.getBuffer() : buffer;
+}
+
+
+
+size_t Uploader::getDrawOffset() const
+{
+    return strategy == UPLOAD_PERSISTENT && ring.isCreated() ? ring.getOffset() : 0;
+}
+
+
+
+void Uploader::drawn()
+{
+    if (strategy == UPLOAD_PERSISTENT)
+        ring.end();
+}
+
+
+
+void Uploader::clearRecent()
+{
+    for (unsigned i = 0; i < StreamRing::SEGMENTS - 1; ++i)
+        recent[i].clear();
+}
+
+
+
+void Uploader::countStall(double ms)
+{
+    if (ms > STALL_MS)
+    {
+        ++stalls;
+        stallTime += ms;
+    }
+}
+
+
+
+double Uploader::getUploadTimeInMilliSec() const
+{
+    return uploadTime;
+}
+
+
+
+unsigned Uploader::getStalls() const
+{
+    return stalls;
+}
+
+
+
+double Uploader::getStallTimeInMilliSec() const
+{
+    return stallTime;
+}
+
+
+
+size_t Uploader::getUploadedBytes() const
+{
+    return uploadedBytes;
+}
+
+
+
+size_t Uploader::getRingBytes() const
+{
+    return ring.getBytes();
+}
+
+
+
+void Uploader::resetStats()
+{
+    stalls = 0;
+    stallTime = 0;
+    ring.resetStats();
+}
@@ -0,0 +1,98 @@
+#ifndef TOWERDEFENSESDL_UPLOADER_H
+#define TOWERDEFENSESDL_UPLOADER_H
+
+#include <stddef.h>
+#include "DirtyRanges.h"
+#include "StreamRing.h"
+#include "Timer.h"
+
+/*
+ * The ways the VBO path can hand a frame of vertices to GL.
+ *
+ * MAP_READ_WRITE keeps the buffer contents, so the sine update can write
+ * y and n.x straight into the mapping, but the map waits for the GPU to
+ * finish with the buffer. MAP_INVALIDATE and ORPHAN give the driver leave
+ * to hand out fresh storage instead of waiting, and in exchange the whole
+ * array has to be written. MAP_UNSYNCHRONIZED neither waits nor renames:
+ * the frame may be written while the GPU still draws the last one, which
+ * can tear. PERSISTENT streams through a StreamRing.
+ *
+ * writeRanges() uploads only the dirty ranges of a frame into a buffer
+ * that keeps the rest of the last one: a flushed map of their span
+ * (GL_MAP_FLUSH_EXPLICIT_BIT) for the map strategies, one glBufferSubData()
+ * per range for ORPHAN, which cannot orphan a buffer it only patches.
+ *
+ * Stalls: the persistent ring counts its fence waits; the other strategies
+ * count map or upload calls that took longer than STALL_MS, since GL gives
+ * no other sign of an implicit wait.
+ */
+
+enum UploadStrategy {
+    UPLOAD_MAP_READ_WRITE = 0,      // glMapBuffer(GL_READ_WRITE)
+    UPLOAD_MAP_INVALIDATE,          // glMapBufferRange(GL_MAP_INVALIDATE_BUFFER_BIT)
+    UPLOAD_MAP_UNSYNCHRONIZED,      // glMapBufferRange(GL_MAP_UNSYNCHRONIZED_BIT)
+    UPLOAD_ORPHAN,                  // glBufferData(NULL) + glBufferSubData()
+    UPLOAD_PERSISTENT,              // persistently mapped ring, see StreamRing
+    nUpload
+};
+
+const char *uploadStrategyName(UploadStrategy strategy);
+bool parseUploadStrategy(const char *name, UploadStrategy *strategy);      // case-insensitive name
+
+class Uploader
+{
+public:
+    static const double STALL_MS;
+
+    Uploader();                                 // default constructor, MAP_READ_WRITE
+
+    void     setStrategy(UploadStrategy strategy);  // the ring is created by the next reset()
+    UploadStrategy getStrategy() const;
+    bool     isSupported(UploadStrategy strategy) const;    // needs a GL context
+
+    // after the VBO was (re)filled: buffer has capacity bytes of storage,
+    // the first bytes of it hold initial
+    void     reset(unsigned buffer, size_t capacity, size_t bytes, const void *initial);
+    void     release();                         // frees the ring, the VBO belongs to the caller
+
+    // does map() return the last frame's vertices, so writing what
+    // changed is enough
+    bool     keepsContents() const;
+    void    *map();                             // this frame's vertices, NULL for ORPHAN or on failure
+    void     unmap();
+    void     write(const void *data, size_t bytes);     // the whole frame, any strategy
+    // the ranges of data in dirty, stride bytes per vertex; the rest of the
+    // buffer is left as the last frame had it
+    void     writeRanges(const void *data, size_t stride, const DirtyRanges &dirty);
+
+    unsigned getDrawBuffer() const;             // where the frame just written is
+    size_t   getDrawOffset() const;
+    void     drawn();                           // after the frame's draws
+
+    double   getUploadTimeInMilliSec() const;   // map to unmap, or the write, of the last frame
+    unsigned getStalls() const;
+    double   getStallTimeInMilliSec() const;    // sum over the stalls
+    size_t   getUploadedBytes() const;          // handed to GL for the last frame
+    size_t   getRingBytes() const;
+    void     resetStats();
+
+
+private:
+    void     clearRecent();
+    void     countStall(double ms);
+
+    UploadStrategy strategy;
+    unsigned buffer;
+    size_t   capacity, bytes;
+    StreamRing ring;
+    Timer    clock;                             // runs from map() to unmap()
+    double   uploadTime;
+    size_t   uploadedBytes;
+    // the ranges written to the last SEGMENTS-1 ring segments, newest
+    // first; the segment written next has missed them
+    DirtyRanges recent[StreamRing::SEGMENTS - 1];
+    unsigned stalls;
+    double   stallTime;
+};
+
+#endif //TOWERDEFENSESDL_UPLOADER_H
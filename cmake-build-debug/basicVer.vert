@@ -8,11 +8,12 @@ Run the program and make sure the geometry draws with its colour being generated
 */
 #define M_PI		3.14159265358979323846
 
-uniform float Time;
-uniform int WaveDim;
+const int MAX_WAVES = 64;
 
-const float A1 = 0.25, k1 = 2.0 * M_PI, w1 = 0.25;
-const float A2 = 0.25, k2 = 2.0 * M_PI, w2 = 0.25;
+uniform float Time;
+uniform float PositionScale;    // object units per gl_Vertex unit, 1/8192 for the compact 16-bit format
+uniform int WaveCount;
+uniform vec3 Waves[MAX_WAVES];  // (A, k, w) per wave, same as sws[] on the CPU
 
 const vec3 lEC = vec3(0.0, 0.0, 1.0);//Light position
 const vec3 Ld = vec3(1.0);
@@ -68,17 +69,25 @@ void main()
 {
   float h;
   vec3 n; // Normal vector
-  float x = gl_Vertex[0];
-  float z = gl_Vertex[2];
-
-    h = A1 * sin(k1 * gl_Vertex.x + w1 * Time) + A2 * sin(k2 * gl_Vertex.z + w2 * Time);
+  float x = gl_Vertex[0] * PositionScale;
+  float z = gl_Vertex[2] * PositionScale;
+
+    // Sum of all waves, phase k * (x^2 + z^2) + w * t as on the CPU
+    float r2 = x * x + z * z;
+    h = 0.0;
+    n = vec3(0.0, 1.0, 0.0);
+    for (int i = 0; i < MAX_WAVES; i++)
+    {
+      if (i >= WaveCount)
+        break;
+      float angle = Waves[i].y * r2 + Waves[i].z * Time;
+      h += Waves[i].x * sin(angle);
 
-    // Calculate normal again.
-    n.x = - A1 * k1 * cos(k1 * gl_Vertex.x + w1 * Time);
-    n.y = 1.0;
-    n.z = - A2 * k2 * cos(k2 * gl_Vertex.z + w2 * Time);
+      // Calculate normal again.
+      n.x -= Waves[i].y * Waves[i].x * cos(angle);
+    }
 
-  vec4 osVert = gl_Vertex + vec4(vec3(0,h,0),1);
+  vec4 osVert = gl_Vertex + vec4(vec3(0,h / PositionScale,0),1);
   vec4 esVert = gl_ModelViewMatrix * osVert;
   vec4 csVert = gl_ProjectionMatrix * esVert;
 
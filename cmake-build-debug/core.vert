@@ -0,0 +1,73 @@
+#version 330 core
+/*
+
+Core-profile vertex shader of CORE_VAO. Position and normal are generic
+attributes instead of gl_Vertex/gl_Normal, the matrices come from glm as
+uniforms instead of the matrix stack, and the light and material the
+compatibility modes take from fixed-function state are constants here.
+With GpuWaves the waves are summed as in basicVer.vert, else the vertices
+arrive displaced by the CPU.
+*/
+const int MAX_WAVES = 64;
+
+layout(location = 0) in vec3 Position;  // object units / PositionScale
+layout(location = 1) in vec3 Normal;
+
+uniform mat4 ModelViewMatrix;
+uniform mat4 ProjectionMatrix;
+uniform mat3 NormalMatrix;
+uniform float PositionScale;    // 1/8192 for the compact 16-bit format, else 1
+uniform bool GpuWaves;
+uniform float Time;
+uniform int WaveCount;
+uniform vec3 Waves[MAX_WAVES];  // (A, k, w) per wave, same as sws[] on the CPU
+
+// initLights() and the default material: material ambient 0.2 x (model
+// ambient 0.2 + light ambient 0.2), material diffuse 0.8 x light diffuse 0.7
+const vec4 Ambient = vec4(0.08, 0.08, 0.08, 1.0);
+const vec4 Diffuse = vec4(0.56, 0.56, 0.56, 1.0);
+const vec3 lEC = vec3(0.0, 0.0, 1.0);//Light position
+const vec3 Ls = vec3(1.0);
+const vec3 Ms = vec3(1.0);
+
+const float shininess = 50.0;
+
+out vec4 Color;
+
+void ComputeLightning(vec3 nEC)
+{
+  Color = Ambient;
+
+  float NDotL = dot(nEC, lEC);
+  if (NDotL > 0.0)
+  {
+    Color+= Diffuse * NDotL;
+
+    vec3 H = normalize(lEC + vec3(0.0, 0.0, 1.0));
+    float nDotH = max(dot(nEC, H), 0.0);
+    Color+= vec4(Ls * Ms * pow(nDotH, shininess), 1);
+  }
+}
+
+void main()
+{
+  vec3 p = Position * PositionScale;
+  vec3 n = Normal;
+
+  if (GpuWaves)
+  {
+    // Sum of all waves, phase k * (x^2 + z^2) + w * t as on the CPU
+    float r2 = p.x * p.x + p.z * p.z;
+    p.y = 0.0;
+    n = vec3(0.0, 1.0, 0.0);
+    for (int i = 0; i < WaveCount && i < MAX_WAVES; i++)
+    {
+      float angle = Waves[i].y * r2 + Waves[i].z * Time;
+      p.y += Waves[i].x * sin(angle);
+      n.x -= Waves[i].y * Waves[i].x * cos(angle);
+    }
+  }
+
+  gl_Position = ProjectionMatrix * ModelViewMatrix * vec4(p, 1.0);
+  ComputeLightning(normalize(NormalMatrix * n));
+}
@@ -0,0 +1,44 @@
+/*
+
+Capture pass of the transform feedback mode: the wave sum of basicVer.vert,
+evaluated once per frame for every vertex (drawn as points, rasterizer
+off), written to the feedback buffer as object-space position and normal.
+The passes after it draw that buffer with lit.vert and pay nothing for the
+waves. Positions leave in object units, the compact format's scale undone.
+*/
+#define M_PI		3.14159265358979323846
+
+const int MAX_WAVES = 64;
+
+uniform float Time;
+uniform float PositionScale;    // object units per gl_Vertex unit, 1/8192 for the compact 16-bit format
+uniform int WaveCount;
+uniform vec3 Waves[MAX_WAVES];  // (A, k, w) per wave, same as sws[] on the CPU
+
+varying vec3 FeedbackPosition;
+varying vec3 FeedbackNormal;
+varying vec4 Color;             // basicFrag.frag reads it; nothing is rasterized
+
+void main()
+{
+  float x = gl_Vertex[0] * PositionScale;
+  float z = gl_Vertex[2] * PositionScale;
+
+  // Sum of all waves, phase k * (x^2 + z^2) + w * t as on the CPU
+  float r2 = x * x + z * z;
+  float h = 0.0;
+  vec3 n = vec3(0.0, 1.0, 0.0);
+  for (int i = 0; i < MAX_WAVES; i++)
+  {
+    if (i >= WaveCount)
+      break;
+    float angle = Waves[i].y * r2 + Waves[i].z * Time;
+    h += Waves[i].x * sin(angle);
+    n.x -= Waves[i].y * Waves[i].x * cos(angle);
+  }
+
+  FeedbackPosition = vec3(x, h, z);
+  FeedbackNormal = normalize(n);
+  Color = vec4(1.0);
+  gl_Position = vec4(FeedbackPosition, 1.0);
+}
@@ -0,0 +1,64 @@
+/*
+
+Displaces the static grid by the height texture the CPU streams through a
+ring of pixel buffers. x/z come from the static buffer of the split streams;
+texel (j, i) holds the height of vertex i*(rows+1)+j, so z runs along s and
+x along t. The normal is taken from the central differences of the texels
+around, the edges repeat their last texel.
+*/
+
+uniform sampler2D Heightmap;
+uniform vec2 GridOrigin;        // (x0, z0)
+uniform vec2 GridStep;          // (dx, dz)
+uniform vec2 TexelSize;         // (1 / (rows + 1), 1 / (cols + 1))
+
+attribute vec2 StaticXZ;        // (x, z), never changes
+
+const vec3 lEC = vec3(0.0, 0.0, 1.0);//Light position
+const vec3 Ls = vec3(1.0);
+const vec3 Ms = vec3(1.0);
+
+const float shininess = 50.0;
+
+varying vec4 Color;
+
+void ComputeLightning(vec3 nEC)
+{
+  vec4 diffuse;
+
+  // Ambient color
+  Color = gl_FrontMaterial.ambient * (gl_LightModel.ambient + gl_LightSource[0].ambient);
+
+  float NDotL = dot(nEC, lEC);
+  if (NDotL > 0.0)
+  {
+    diffuse = gl_FrontMaterial.diffuse * gl_LightSource[0].diffuse;
+    diffuse*= NDotL;
+    Color+= diffuse;
+
+    vec3 H = normalize(lEC + vec3(0.0, 0.0, 1.0));
+    float nDotH = max(dot(nEC, H), 0.0);
+    Color+= vec4(Ls * Ms * pow(nDotH, shininess), 1);
+  }
+}
+
+float height(vec2 st)
+{
+  return texture2DLod(Heightmap, st, 0.0).r;
+}
+
+void main()
+{
+  // the centre of the vertex's texel
+  vec2 ij = (StaticXZ - GridOrigin) / GridStep;
+  vec2 st = (vec2(ij.y, ij.x) + 0.5) * TexelSize;
+
+  float h = height(st);
+  float dhdx = (height(st + vec2(0.0, TexelSize.y)) - height(st - vec2(0.0, TexelSize.y))) / (2.0 * GridStep.x);
+  float dhdz = (height(st + vec2(TexelSize.x, 0.0)) - height(st - vec2(TexelSize.x, 0.0))) / (2.0 * GridStep.y);
+  vec3 n = normalize(vec3(-dhdx, 1.0, -dhdz));
+
+  vec4 osVert = vec4(StaticXZ.x, h, StaticXZ.y, 1.0);
+  gl_Position = gl_ModelViewProjectionMatrix * osVert;
+  ComputeLightning(normalize(gl_NormalMatrix * n));
+}
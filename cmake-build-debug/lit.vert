@@ -0,0 +1,39 @@
+/*
+
+Trivial vertex shader for vertices that are displaced already, such as the
+transform feedback buffer: transform and light, no waves.
+*/
+
+const vec3 lEC = vec3(0.0, 0.0, 1.0);//Light position
+const vec3 Ls = vec3(1.0);
+const vec3 Ms = vec3(1.0);
+
+const float shininess = 50.0;
+
+varying vec4 Color;
+
+void ComputeLightning(vec3 nEC)
+{
+  vec4 diffuse;
+
+  // Ambient color
+  Color = gl_FrontMaterial.ambient * (gl_LightModel.ambient + gl_LightSource[0].ambient);
+
+  float NDotL = dot(nEC, lEC);
+  if (NDotL > 0.0)
+  {
+    diffuse = gl_FrontMaterial.diffuse * gl_LightSource[0].diffuse;
+    diffuse*= NDotL;
+    Color+= diffuse;
+
+    vec3 H = normalize(lEC + vec3(0.0, 0.0, 1.0));
+    float nDotH = max(dot(nEC, H), 0.0);
+    Color+= vec4(Ls * Ms * pow(nDotH, shininess), 1);
+  }
+}
+
+void main()
+{
+  gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
+  ComputeLightning(normalize(gl_NormalMatrix * gl_Normal));
+}
@@ -0,0 +1,47 @@
+/*
+
+Pass-through vertex shader for the split VBO streams. The grid's x/z come
+from a static buffer uploaded once, height and slope from the small dynamic
+buffer the CPU update rewrites every frame. The normal of the sine waves is
+(n.x, 1, 0), so the slope is all that needs to be streamed.
+*/
+
+attribute vec2 StaticXZ;        // (x, z), never changes
+attribute vec2 HeightSlope;     // (r.y, n.x) of the current frame
+
+const vec3 lEC = vec3(0.0, 0.0, 1.0);//Light position
+const vec3 Ls = vec3(1.0);
+const vec3 Ms = vec3(1.0);
+
+const float shininess = 50.0;
+
+varying vec4 Color;
+
+void ComputeLightning(vec3 nEC)
+{
+  vec4 diffuse;
+
+  // Ambient color
+  Color = gl_FrontMaterial.ambient * (gl_LightModel.ambient + gl_LightSource[0].ambient);
+
+  float NDotL = dot(nEC, lEC);
+  if (NDotL > 0.0)
+  {
+    diffuse = gl_FrontMaterial.diffuse * gl_LightSource[0].diffuse;
+    diffuse*= NDotL;
+    Color+= diffuse;
+
+    vec3 H = normalize(lEC + vec3(0.0, 0.0, 1.0));
+    float nDotH = max(dot(nEC, H), 0.0);
+    Color+= vec4(Ls * Ms * pow(nDotH, shininess), 1);
+  }
+}
+
+void main()
+{
+  vec4 osVert = vec4(StaticXZ.x, HeightSlope.x, StaticXZ.y, 1.0);
+  vec3 n = normalize(vec3(HeightSlope.y, 1.0, 0.0));
+
+  gl_Position = gl_ModelViewProjectionMatrix * osVert;
+  ComputeLightning(normalize(gl_NormalMatrix * n));
+}
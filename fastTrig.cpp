@@ -0,0 +1,208 @@
+#include "fastTrig.h"
+#include "Timer.h"
+#include <math.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <vector>
+
+TrigTier trigTier = TRIG_LIBM;
+
+static const char *TRIG_STRING[] = {
+        "LIBM",
+        "POLY9",
+        "POLY5",
+        "LUT"
+};
+
+// sin(r) = r * P(r^2) on [-pi/2, pi/2], minimax for relative error
+static const float POLY9_C0 = 9.9999999469e-01f;
+static const float POLY9_C1 = -1.6666656684e-01f;
+static const float POLY9_C2 = 8.3330251390e-03f;
+static const float POLY9_C3 = -1.9807418727e-04f;
+static const float POLY9_C4 = 2.6019030677e-06f;
+
+static const float POLY5_C0 = 9.9989182126e-01f;
+static const float POLY5_C1 = -1.6596011654e-01f;
+static const float POLY5_C2 = 7.6029033433e-03f;
+
+static const int LUT_BITS = 12;
+static const int LUT_SIZE = 1 << LUT_BITS;
+static const double LUT_SCALE = LUT_SIZE / (2 * M_PI);
+static float lut[LUT_SIZE + 1];                 // sin over one period, last entry repeats the first
+
+
+// filled during static initialization, before any thread can read it
+static bool buildLut()
+{
+    for (int i = 0; i <= LUT_SIZE; ++i)
+        lut[i] = (float) sin(i / LUT_SCALE);
+    return true;
+}
+static const bool lutReady = buildLut();
+
+static inline float poly9(float r)
+{
+    float r2 = r * r;
+    return r * ((((POLY9_C4 * r2 + POLY9_C3) * r2 + POLY9_C2) * r2 + POLY9_C1) * r2 + POLY9_C0);
+}
+
+static inline float poly5(float r)
+{
+    float r2 = r * r;
+    return r * ((POLY5_C2 * r2 + POLY5_C1) * r2 + POLY5_C0);
+}
+
+static inline float poly(TrigTier tier, float r)
+{
+    return tier == TRIG_POLY9 ? poly9(r) : poly5(r);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sin(x) (quarter = 0) or cos(x) = sin(x + pi/2) (quarter = 1) from the
+// polynomial: sin(r) = P(r) and cos(r) = P(pi/2 - |r|), both arguments in
+// the fitted range, picked and signed by the quadrant
+///////////////////////////////////////////////////////////////////////////////
+static inline float polyQuadrant(TrigTier tier, float x, int quarter)
+{
+    float r;
+    int j = trigReduce(x, &r) + quarter;
+    float v = (j & 1) ? poly(tier, (float) M_PI_2 - fabsf(r)) : poly(tier, r);
+    return (j & 2) ? -v : v;
+}
+
+// offset 0 for sin, LUT_SIZE / 4 for cos
+static inline float lookup(float x, int offset)
+{
+    double u = x * LUT_SCALE;
+    long long i = (long long) u;
+    if (u < i)
+        --i;
+    float f = (float) (u - i);
+    int k = (int) ((i + offset) & (LUT_SIZE - 1));
+    return lut[k] + f * (lut[k + 1] - lut[k]);
+}
+
+
+const char *trigTierName(TrigTier tier)
+{
+    return tier < nTrig ? TRIG_STRING[tier] : "UNKNOWN";
+}
+
+bool parseTrigTier(const char *name, TrigTier *tier)
+{
+    for (int i = 0; i < nTrig; ++i)
+    {
+        const char *a = name, *b = TRIG_STRING[i];
+        while (*a && tolower((unsigned char) *a) == tolower((unsigned char) *b))
+            ++a, ++b;
+        if (!*a && !*b)
+        {
+            *tier = (TrigTier) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// sin/cos in the given tier
+///////////////////////////////////////////////////////////////////////////////
+static inline float sinTier(TrigTier tier, float x)
+{
+    if (tier == TRIG_LIBM || fabsf(x) > TRIG_MAX_ARG)
+        return sinf(x);
+    if (tier == TRIG_LUT)
+        return lookup(x, 0);
+    return polyQuadrant(tier, x, 0);
+}
+
+static inline float cosTier(TrigTier tier, float x)
+{
+    if (tier == TRIG_LIBM || fabsf(x) > TRIG_MAX_ARG)
+        return cosf(x);
+    if (tier == TRIG_LUT)
+        return lookup(x, LUT_SIZE / 4);
+    return polyQuadrant(tier, x, 1);
+}
+
+float trigSin(float x)
+{
+    return sinTier(trigTier, x);
+}
+
+float trigCos(float x)
+{
+    return cosTier(trigTier, x);
+}
+
+void trigSinCos(float x, float *s, float *c)
+{
+    *s = sinTier(trigTier, x);
+    *c = cosTier(trigTier, x);
+}
+
+void trigSinCosIn(TrigTier tier, float x, float *s, float *c)
+{
+    *s = sinTier(tier, x);
+    *c = cosTier(tier, x);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// error and speed of every tier. ULP are measured in float at the exact
+// result, skipping results below 2^-8 where an absolute error of a few
+// 1e-8 already reads as thousands of ulp.
+///////////////////////////////////////////////////////////////////////////////
+void sweepTrig(float lo, float hi, unsigned n)
+{
+    if (n < 2)
+        n = 2;
+    (void) lutReady;
+
+    std::vector<float> args(n);
+    for (unsigned i = 0; i < n; ++i)
+        args[i] = lo + (hi - lo) * i / (n - 1);
+
+    printf("trig sweep over [%g, %g], %u arguments\n", lo, hi, n);
+    printf("%-8s %12s %12s %10s\n", "tier", "max abs", "max ulp", "ns/op");
+    for (int t = 0; t < nTrig; ++t)
+    {
+        TrigTier tier = (TrigTier) t;
+        double maxAbs = 0, maxUlp = 0;
+        for (unsigned i = 0; i < n; ++i)
+        {
+            double ref[2] = {sin((double) args[i]), cos((double) args[i])};
+            float got[2] = {sinTier(tier, args[i]), cosTier(tier, args[i])};
+            for (int k = 0; k < 2; ++k)
+            {
+                double err = fabs(got[k] - ref[k]);
+                if (err > maxAbs)
+                    maxAbs = err;
+                if (fabs(ref[k]) >= 1.0 / 256)
+                {
+                    int e;
+                    frexp(ref[k], &e);
+                    double ulp = ldexp(1.0, e - 24);
+                    if (err / ulp > maxUlp)
+                        maxUlp = err / ulp;
+                }
+            }
+        }
+
+        // sum the results so the calls are not optimized away
+        volatile float sink = 0;
+        float acc = 0;
+        Timer timer;
+        timer.start();
+        for (unsigned i = 0; i < n; ++i)
+            acc += sinTier(tier, args[i]) + cosTier(tier, args[i]);
+        timer.stop();
+        sink = acc;
+        (void) sink;
+
+        printf("%-8s %12.3g %12.1f %10.2f\n", trigTierName(tier), maxAbs, maxUlp,
+               timer.getElapsedTimeInMicroSec() * 1000.0 / n);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef TOWERDEFENSESDL_FASTTRIG_H
+#define TOWERDEFENSESDL_FASTTRIG_H
+
+/*
+ * Scalar sin/cos in several precision tiers, picked at runtime by trigTier.
+ *
+ * The polynomial tiers reduce x to r = x - j * pi/2, |r| <= pi/4 (Cody-Waite
+ * with a three part pi/2), and evaluate an odd minimax polynomial P of sin
+ * on [-pi/2, pi/2] fitted for relative error: sin(r) = P(r) and
+ * cos(r) = P(pi/2 - |r|), picked and signed by the quadrant j. The LUT
+ * tier interpolates linearly in a 4096 entry table over one period, the
+ * phase is reduced in double. Arguments beyond +-TRIG_MAX_ARG fall back to
+ * libm in every tier.
+ *
+ * Max error over [-1000, 1000] against double sin/cos, from --trig-sweep
+ * (ULP counted in float at the exact result, for |result| >= 2^-8):
+ *   LIBM    sinf/cosf                      0.6 ulp,   abs 3.2e-8
+ *   POLY9   degree 9, rel 5.3e-9 fit       2.9 ulp,   abs 1.7e-7
+ *   POLY5   degree 5, rel 1.1e-4 fit       1816 ulp,  abs 1.1e-4
+ *   LUT     4096 entries, linear           6 ulp,     abs 3.5e-7
+ */
+
+enum TrigTier {
+    TRIG_LIBM = 0,
+    TRIG_POLY9,
+    TRIG_POLY5,
+    TRIG_LUT,
+    nTrig
+};
+
+const float TRIG_MAX_ARG = 8192.0f;
+
+// pi/2 split in three parts for Cody-Waite range reduction (Cephes), shared
+// by the polynomial tiers and the SIMD kernels of waveKernel.cpp
+const float TRIG_PIO2_1 = 1.5703125f;
+const float TRIG_PIO2_2 = 4.837512969970703125e-4f;
+const float TRIG_PIO2_3 = 7.54978995489188216e-8f;
+const float TRIG_TWO_OVER_PI = 0.636619772367581343f;
+
+// x = j * pi/2 + r with |r| <= pi/4, returns j. The cast rounds to nearest
+// without the floorf call that x86 without SSE4.1 would make. The SIMD
+// kernels do the same per lane.
+inline int trigReduce(float x, float *r)
+{
+    float q = x * TRIG_TWO_OVER_PI;
+    int j = (int) (q + (q >= 0 ? 0.5f : -0.5f));
+    float fj = (float) j;
+    *r = ((x - fj * TRIG_PIO2_1) - fj * TRIG_PIO2_2) - fj * TRIG_PIO2_3;
+    return j;
+}
+
+extern TrigTier trigTier;           // tier used by trigSin/trigCos/trigSinCos
+
+const char *trigTierName(TrigTier tier);
+bool parseTrigTier(const char *name, TrigTier *tier);     // "libm", "poly9", "poly5", "lut"
+
+float trigSin(float x);
+float trigCos(float x);
+void  trigSinCos(float x, float *s, float *c);
+void  trigSinCosIn(TrigTier tier, float x, float *s, float *c);     // for threads that snapshot the tier
+
+// print max abs / ULP error and ns per sin+cos pair of every tier,
+// sampling n arguments evenly over [lo, hi]
+void  sweepTrig(float lo, float hi, unsigned n);
+
+#endif //TOWERDEFENSESDL_FASTTRIG_H
@@ -0,0 +1,167 @@
+#include "gridAlloc.h"
+#include <atomic>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+bool gridHugePages = true;
+
+static std::atomic<size_t> reserved(0);
+static std::atomic<size_t> huge(0);
+static std::atomic<unsigned> blocks(0);
+
+enum BlockKind {
+    BLOCK_ALIGNED = 0,              // posix_memalign / _aligned_malloc
+    BLOCK_HUGE,                     // as above, 2 MB aligned with MADV_HUGEPAGE
+    BLOCK_LARGE_PAGES               // VirtualAlloc(MEM_LARGE_PAGES)
+};
+
+// One cache line in front of every block remembers how to free it, so the
+// caller's pointer stays GRID_ALIGN aligned
+typedef struct {
+    void *base;                     // what the system returned
+    size_t reserved;
+    BlockKind kind;
+} BlockHeader;
+
+static_assert(sizeof(BlockHeader) <= GRID_ALIGN, "BlockHeader must fit in the alignment padding");
+
+
+static size_t roundUp(size_t n, size_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+static void *alignedBlock(size_t bytes, size_t align)
+{
+#ifdef _WIN32
+    return _aligned_malloc(bytes, align);
+#else
+    void *p = NULL;
+    return posix_memalign(&p, align, bytes) ? NULL : p;
+#endif
+}
+
+static void freeAligned(void *p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// a huge page backed block of total bytes, NULL if the system has none
+///////////////////////////////////////////////////////////////////////////////
+static void *hugeBlock(size_t total, size_t *reservedBytes, BlockKind *kind)
+{
+#ifdef _WIN32
+    SIZE_T page = GetLargePageMinimum();
+    if (!page)
+        return NULL;
+    size_t bytes = roundUp(total, page);
+    void *p = VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (!p)
+        return NULL;
+    *reservedBytes = bytes;
+    *kind = BLOCK_LARGE_PAGES;
+    return p;
+#elif defined(MADV_HUGEPAGE)
+    size_t bytes = roundUp(total, GRID_HUGE_PAGE);
+    void *p = alignedBlock(bytes, GRID_HUGE_PAGE);
+    if (!p)
+        return NULL;
+    // only a hint, without THP the block simply stays on 4K pages
+    madvise(p, bytes, MADV_HUGEPAGE);
+    *reservedBytes = bytes;
+    *kind = BLOCK_HUGE;
+    return p;
+#else
+    (void) total;
+    (void) reservedBytes;
+    (void) kind;
+    return NULL;
+#endif
+}
+
+
+void *gridAlloc(size_t bytes)
+{
+    if (!bytes)
+        return NULL;
+
+    size_t total = bytes + GRID_ALIGN;
+    size_t reservedBytes = 0;
+    BlockKind kind = BLOCK_ALIGNED;
+    void *base = NULL;
+
+    if (gridHugePages && total >= GRID_HUGE_PAGE)
+        base = hugeBlock(total, &reservedBytes, &kind);
+    if (!base)
+    {
+        reservedBytes = roundUp(total, GRID_ALIGN);
+        kind = BLOCK_ALIGNED;
+        base = alignedBlock(reservedBytes, GRID_ALIGN);
+        if (!base)
+            return NULL;
+    }
+
+    BlockHeader *header = (BlockHeader *) base;
+    header->base = base;
+    header->reserved = reservedBytes;
+    header->kind = kind;
+
+    reserved += reservedBytes;
+    if (kind != BLOCK_ALIGNED)
+        huge += reservedBytes;
+    ++blocks;
+    return (char *) base + GRID_ALIGN;
+}
+
+void gridFree(void *block)
+{
+    if (!block)
+        return;
+
+    BlockHeader header = *(BlockHeader *) ((char *) block - GRID_ALIGN);
+    reserved -= header.reserved;
+    if (header.kind != BLOCK_ALIGNED)
+        huge -= header.reserved;
+    --blocks;
+
+#ifdef _WIN32
+    if (header.kind == BLOCK_LARGE_PAGES)
+    {
+        VirtualFree(header.base, 0, MEM_RELEASE);
+        return;
+    }
+#endif
+    freeAligned(header.base);
+}
+
+size_t gridReservedBytes()
+{
+    return reserved;
+}
+
+size_t gridHugeBytes()
+{
+    return huge;
+}
+
+unsigned gridBlockCount()
+{
+    return blocks;
+}
+
+size_t gridGrowCapacity(size_t capacity, size_t needed)
+{
+    size_t grown = capacity + capacity / 2;
+    return grown > needed ? grown : needed;
+}
@@ -0,0 +1,58 @@
+#ifndef TOWERDEFENSESDL_GRIDALLOC_H
+#define TOWERDEFENSESDL_GRIDALLOC_H
+
+#include <stddef.h>
+#include <new>
+
+/*
+ * Allocator for the large per-vertex arrays (grid vertices and indices, the
+ * SoA mirror, recurrence phasors).
+ *
+ * Every block is GRID_ALIGN (cache line) aligned. Blocks of at least
+ * GRID_HUGE_PAGE bytes are backed by 2 MB pages when gridHugePages is on:
+ * on Linux the block is 2 MB aligned and madvise(MADV_HUGEPAGE) asks for
+ * transparent huge pages, on Windows VirtualAlloc(MEM_LARGE_PAGES) is tried,
+ * which needs the "Lock pages in memory" privilege. Anything that fails
+ * falls back to an ordinary aligned block, so huge pages are only a hint.
+ */
+
+const size_t GRID_ALIGN = 64;
+const size_t GRID_HUGE_PAGE = 2 * 1024 * 1024;
+
+extern bool gridHugePages;          // back large blocks with huge pages (--no-huge-pages)
+
+void  *gridAlloc(size_t bytes);     // NULL on failure or for 0 bytes
+void   gridFree(void *block);       // NULL is ignored
+
+size_t gridReservedBytes();         // reserved by all live blocks, padding included
+size_t gridHugeBytes();             // part of it in huge page blocks
+unsigned gridBlockCount();
+
+// capacity for needed elements when capacity is too small: at least half
+// again as much, so a run of small steps reallocates O(log n) times
+size_t gridGrowCapacity(size_t capacity, size_t needed);
+
+// std allocator on top of gridAlloc(), for std::vector scratch arrays
+template <typename T>
+struct GridAllocator {
+    typedef T value_type;
+
+    GridAllocator() {}
+    template <typename U> GridAllocator(const GridAllocator<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        void *p = gridAlloc(n * sizeof(T));
+        if (!p)
+            throw std::bad_alloc();
+        return (T *) p;
+    }
+    void deallocate(T *p, size_t) { gridFree(p); }
+};
+
+template <typename T, typename U>
+bool operator==(const GridAllocator<T> &, const GridAllocator<U> &) { return true; }
+template <typename T, typename U>
+bool operator!=(const GridAllocator<T> &, const GridAllocator<U> &) { return false; }
+
+#endif //TOWERDEFENSESDL_GRIDALLOC_H
@@ -0,0 +1,373 @@
+#include "gridIndex.h"
+#include "Timer.h"
+#include <math.h>
+#include <stdio.h>
+
+static const char *STITCH_STRING[] = {
+        "RESTART",
+        "DEGENERATE"
+};
+
+static const char *ORDER_STRING[] = {
+        "STRIPS",
+        "BLOCKED",
+        "FORSYTH"
+};
+
+// Forsyth's scoring constants and the largest cache his tables are built for
+static const float FORSYTH_CACHE_DECAY = 1.5f;
+static const float FORSYTH_LAST_TRI = 0.75f;
+static const float FORSYTH_VALENCE_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_POWER = 0.5f;
+static const unsigned FORSYTH_MAX_CACHE = 64;
+static const unsigned FORSYTH_MAX_VALENCE = 32;
+
+
+const char *stitchModeName(StitchMode mode)
+{
+    return mode < nStitch ? STITCH_STRING[mode] : "UNKNOWN";
+}
+
+template <typename T>
+void stitchGridStrips(std::vector<T> &out, unsigned rows, unsigned cols, StitchMode mode, T restart)
+{
+    unsigned strip = (rows + 1) * 2;
+    unsigned joins = cols > 0 ? cols - 1 : 0;
+    out.clear();
+    out.reserve(cols * strip + joins * (mode == STITCH_RESTART ? 1 : 2));
+
+    for (unsigned i = 0; i < cols; i++) {
+        if (i > 0) {
+            if (mode == STITCH_RESTART) {
+                out.push_back(restart);
+            } else {
+                // last index of the previous strip, first of this one
+                out.push_back(out.back());
+                out.push_back((T) (i * (rows + 1)));
+            }
+        }
+        for (unsigned j = 0; j <= rows; j++) {
+            out.push_back((T) (i * (rows + 1) + j));
+            out.push_back((T) ((i + 1) * (rows + 1) + j));
+        }
+    }
+}
+
+template void stitchGridStrips<unsigned short>(std::vector<unsigned short> &, unsigned, unsigned, StitchMode,
+                                               unsigned short);
+template void stitchGridStrips<unsigned>(std::vector<unsigned> &, unsigned, unsigned, StitchMode, unsigned);
+
+bool fitsShortIndices(unsigned nVertices, StitchMode mode)
+{
+    return mode == STITCH_RESTART ? nVertices < 0xFFFF : nVertices <= 0x10000;
+}
+
+
+const char *indexOrderName(IndexOrder order)
+{
+    return order < nOrder ? ORDER_STRING[order] : "UNKNOWN";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the two triangles of the quad between columns i, i + 1 and rows j, j + 1,
+// wound like the strip would wind them
+///////////////////////////////////////////////////////////////////////////////
+static inline void pushQuad(std::vector<unsigned> &out, unsigned rows, unsigned i, unsigned j)
+{
+    unsigned a0 = i * (rows + 1) + j, b0 = a0 + rows + 1;
+    unsigned a1 = a0 + 1, b1 = b0 + 1;
+    out.push_back(a0);
+    out.push_back(b0);
+    out.push_back(a1);
+    out.push_back(a1);
+    out.push_back(b0);
+    out.push_back(b1);
+}
+
+void gridTriangles(std::vector<unsigned> &out, unsigned rows, unsigned cols)
+{
+    out.clear();
+    out.reserve((size_t) rows * cols * 6);
+    for (unsigned i = 0; i < cols; i++)
+        for (unsigned j = 0; j < rows; j++)
+            pushQuad(out, rows, i, j);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// a band of B rows touches B + 1 vertices per column; walking the band
+// column by column needs the previous column (B + 1) and the current one
+// (B + 1) in the cache, so B = cacheSize / 2 - 1
+///////////////////////////////////////////////////////////////////////////////
+void blockedGridTriangles(std::vector<unsigned> &out, unsigned rows, unsigned cols, unsigned cacheSize)
+{
+    unsigned band = cacheSize / 2 > 1 ? cacheSize / 2 - 1 : 1;
+    out.clear();
+    out.reserve((size_t) rows * cols * 6);
+    for (unsigned j0 = 0; j0 < rows; j0 += band)
+    {
+        unsigned j1 = j0 + band < rows ? j0 + band : rows;
+        for (unsigned i = 0; i < cols; i++)
+            for (unsigned j = j0; j < j1; j++)
+                pushQuad(out, rows, i, j);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Forsyth, "Linear-Speed Vertex Cache Optimisation" (2006). Each vertex
+// scores by its position in a simulated LRU cache plus a bonus for having
+// few triangles left; the next triangle is the best scoring one touching
+// the cache. When the cache runs dry the next unused triangle in input
+// order restarts it, which keeps the whole pass linear.
+///////////////////////////////////////////////////////////////////////////////
+void optimizeForsyth(std::vector<unsigned> &list, unsigned nVertices, unsigned cacheSize,
+                     const std::function<bool()> &cancelled)
+{
+    if (cacheSize < 4)
+        cacheSize = 4;
+    if (cacheSize > FORSYTH_MAX_CACHE)
+        cacheSize = FORSYTH_MAX_CACHE;
+    unsigned nTris = (unsigned) (list.size() / 3);
+    if (!nTris)
+        return;
+
+    // score tables by cache position and by remaining valence
+    float cacheScore[FORSYTH_MAX_CACHE];
+    for (unsigned p = 0; p < cacheSize; ++p)
+        cacheScore[p] = p < 3 ? FORSYTH_LAST_TRI
+                              : powf(1.0f - (float) (p - 3) / (cacheSize - 3), FORSYTH_CACHE_DECAY);
+    float valenceScore[FORSYTH_MAX_VALENCE];
+    for (unsigned v = 1; v < FORSYTH_MAX_VALENCE; ++v)
+        valenceScore[v] = FORSYTH_VALENCE_SCALE * powf((float) v, -FORSYTH_VALENCE_POWER);
+    valenceScore[0] = 0;
+
+    // vertex -> triangles, as offsets into one array
+    std::vector<unsigned> offset(nVertices + 1, 0), active(nVertices, 0);
+    for (unsigned idx : list)
+        ++active[idx];
+    for (unsigned v = 0; v < nVertices; ++v)
+        offset[v + 1] = offset[v] + active[v];
+    std::vector<unsigned> vertexTris(offset[nVertices]);
+    {
+        std::vector<unsigned> fill(offset.begin(), offset.end() - 1);
+        for (unsigned t = 0; t < nTris; ++t)
+            for (int k = 0; k < 3; ++k)
+                vertexTris[fill[list[3 * t + k]]++] = t;
+    }
+
+    std::vector<int> cachePos(nVertices, -1);
+    std::vector<float> vertexScore(nVertices);
+    auto score = [&](unsigned v) {
+        if (!active[v])
+            return -1.0f;
+        float s = cachePos[v] < 0 ? 0.0f : cacheScore[cachePos[v]];
+        return s + valenceScore[active[v] < FORSYTH_MAX_VALENCE ? active[v] : FORSYTH_MAX_VALENCE - 1];
+    };
+    for (unsigned v = 0; v < nVertices; ++v)
+        vertexScore[v] = score(v);
+
+    std::vector<float> triScore(nTris);
+    std::vector<bool> emitted(nTris, false);
+    for (unsigned t = 0; t < nTris; ++t)
+        triScore[t] = vertexScore[list[3 * t]] + vertexScore[list[3 * t + 1]] + vertexScore[list[3 * t + 2]];
+
+    std::vector<unsigned> out;
+    out.reserve(list.size());
+    std::vector<unsigned> cache, next;
+    cache.reserve(cacheSize + 3);
+    next.reserve(cacheSize + 3);
+    unsigned cursor = 0;
+    int best = 0;
+
+    for (unsigned n = 0; n < nTris; ++n)
+    {
+        if ((n & 4095) == 0 && cancelled && cancelled())
+            return;
+        if (best < 0)
+        {
+            while (emitted[cursor])
+                ++cursor;
+            best = (int) cursor;
+        }
+
+        unsigned t = (unsigned) best;
+        emitted[t] = true;
+        const unsigned *tri = &list[3 * t];
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned v = tri[k];
+            out.push_back(v);
+            // drop t from the vertex's live triangles
+            unsigned *begin = &vertexTris[offset[v]], *end = begin + active[v];
+            for (unsigned *p = begin; p < end; ++p)
+                if (*p == t)
+                {
+                    *p = end[-1];
+                    break;
+                }
+            --active[v];
+        }
+
+        // move the triangle's vertices to the front of the LRU cache
+        next.assign(tri, tri + 3);
+        for (unsigned v : cache)
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                next.push_back(v);
+        cache.swap(next);
+
+        for (unsigned p = 0; p < cache.size(); ++p)
+            cachePos[cache[p]] = p < cacheSize ? (int) p : -1;
+        if (cache.size() > cacheSize)
+            cache.resize(cacheSize);
+        // vertices pushed out above still need their scores lowered
+        for (unsigned p = 0; p < next.size(); ++p)
+            if (cachePos[next[p]] < 0)
+                vertexScore[next[p]] = score(next[p]);
+
+        // rescore everything in the cache and pick the best triangle it touches
+        best = -1;
+        float bestScore = -1;
+        for (unsigned v : cache)
+            vertexScore[v] = score(v);
+        for (unsigned v : cache)
+        {
+            for (unsigned k = 0; k < active[v]; ++k)
+            {
+                unsigned u = vertexTris[offset[v] + k];
+                const unsigned *w = &list[3 * u];
+                triScore[u] = vertexScore[w[0]] + vertexScore[w[1]] + vertexScore[w[2]];
+                if (triScore[u] > bestScore)
+                {
+                    bestScore = triScore[u];
+                    best = (int) u;
+                }
+            }
+        }
+    }
+
+    list.swap(out);
+}
+
+
+template <typename T>
+IndexStats analyzeIndices(const std::vector<T> &indices, bool strip, T restart, unsigned cacheSize)
+{
+    IndexStats stats = {0, 0, 0, 0, 0};
+    if (indices.empty() || !cacheSize)
+        return stats;
+
+    // FIFO: a vertex inserted as the n-th miss is evicted by the
+    // (n + cacheSize)-th, so it is cached while misses - insertedAt <= size
+    const unsigned NONE = ~0u;
+    T maxIndex = 0;
+    for (T idx : indices)
+        if (!(strip && idx == restart) && idx > maxIndex)
+            maxIndex = idx;
+    std::vector<unsigned> insertedAt((size_t) maxIndex + 1, NONE);
+
+    unsigned run = 0;               // indices since the strip (re)started
+    T a = 0, b = 0;                 // last two indices of the strip
+    for (size_t n = 0; n < indices.size(); ++n)
+    {
+        T idx = indices[n];
+        if (strip && idx == restart)
+        {
+            run = 0;
+            continue;
+        }
+
+        if (insertedAt[idx] == NONE)
+            ++stats.vertices;
+        if (insertedAt[idx] == NONE || stats.misses - insertedAt[idx] >= cacheSize)
+            insertedAt[idx] = stats.misses++;
+
+        if (strip)
+        {
+            if (++run >= 3 && a != b && b != idx && a != idx)
+                ++stats.triangles;
+            a = b;
+            b = idx;
+        }
+        else if (n % 3 == 2)
+        {
+            ++stats.triangles;
+        }
+    }
+
+    stats.acmr = stats.triangles ? (float) stats.misses / stats.triangles : 0;
+    stats.atvr = stats.vertices ? (float) stats.misses / stats.vertices : 0;
+    return stats;
+}
+
+template IndexStats analyzeIndices<unsigned short>(const std::vector<unsigned short> &, bool, unsigned short,
+                                                   unsigned);
+template IndexStats analyzeIndices<unsigned>(const std::vector<unsigned> &, bool, unsigned, unsigned);
+
+
+IndexStats orderGridIndices(std::vector<unsigned> &list, IndexOrder order, unsigned rows, unsigned cols,
+                            StitchMode stitch, unsigned cacheSize, const std::function<bool()> &cancelled)
+{
+    switch (order)
+    {
+        case ORDER_BLOCKED:
+            blockedGridTriangles(list, rows, cols, cacheSize);
+            break;
+        case ORDER_FORSYTH:
+            gridTriangles(list, rows, cols);
+            optimizeForsyth(list, (rows + 1) * (cols + 1), cacheSize, cancelled);
+            break;
+        default:
+            stitchGridStrips<unsigned>(list, rows, cols, stitch, 0xFFFFFFFF);
+            return analyzeIndices<unsigned>(list, true, 0xFFFFFFFF, cacheSize);
+    }
+    return analyzeIndices<unsigned>(list, false, 0xFFFFFFFF, cacheSize);
+}
+
+bool SingleIndices::matches(unsigned rows, unsigned cols, IndexOrder order, StitchMode stitch,
+                            unsigned cacheSize) const
+{
+    return this->rows && rows == this->rows && cols == this->cols && order == this->order &&
+           stitch == this->stitch && cacheSize == this->cacheSize;
+}
+
+bool orderSingleIndices(SingleIndices *single, unsigned rows, unsigned cols, IndexOrder order, StitchMode stitch,
+                        unsigned cacheSize, const std::function<bool()> &cancelled)
+{
+    single->rows = 0;
+    single->stripStats = orderGridIndices(single->list, ORDER_STRIPS, rows, cols, stitch, cacheSize);
+    single->stats = order == ORDER_STRIPS ? single->stripStats
+                                          : orderGridIndices(single->list, order, rows, cols, stitch, cacheSize,
+                                                             cancelled);
+    if (cancelled && cancelled())
+        return false;
+
+    single->rows = rows;
+    single->cols = cols;
+    single->order = order;
+    single->stitch = stitch;
+    single->cacheSize = cacheSize;
+    return true;
+}
+
+void reportIndexOrders(unsigned rows, unsigned cols, unsigned cacheSize)
+{
+    unsigned sizes[] = {cacheSize / 2, cacheSize, cacheSize * 2};
+    std::vector<unsigned> list;
+
+    printf("index orders on a %u x %u grid, FIFO post-transform cache\n", rows, cols);
+    printf("%-8s %6s %8s %8s %10s\n", "order", "cache", "ACMR", "ATVR", "build ms");
+    for (int o = 0; o < nOrder; ++o)
+    {
+        for (unsigned size : sizes)
+        {
+            if (size < 4)
+                continue;
+            Timer timer;
+            timer.start();
+            IndexStats stats = orderGridIndices(list, (IndexOrder) o, rows, cols, STITCH_RESTART, size);
+            timer.stop();
+            printf("%-8s %6u %8.3f %8.3f %10.1f\n", indexOrderName((IndexOrder) o), size, stats.acmr, stats.atvr,
+                   timer.getElapsedTimeInMilliSec());
+        }
+    }
+}
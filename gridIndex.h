@@ -0,0 +1,116 @@
+#ifndef TOWERDEFENSESDL_GRIDINDEX_H
+#define TOWERDEFENSESDL_GRIDINDEX_H
+
+#include <functional>
+#include <vector>
+
+/*
+ * Index streams that submit the whole grid in one draw call.
+ *
+ * The grid is one triangle strip per column (see buildGridArrays()). For a
+ * single glDrawElements the strips are joined either by a primitive restart
+ * index, or by repeating the last index of a strip and the first of the
+ * next: the four zero-area triangles in between are culled by the
+ * rasterizer, and since every strip has an even length the winding of the
+ * next strip is kept.
+ */
+
+enum StitchMode {
+    STITCH_RESTART = 0,             // GL 3.1 primitive restart, one index between strips
+    STITCH_DEGENERATE,              // two repeated indices between strips
+    nStitch
+};
+
+const char *stitchModeName(StitchMode mode);
+
+// indices of the stitched grid, restart is the restart index for STITCH_RESTART
+template <typename T>
+void stitchGridStrips(std::vector<T> &out, unsigned rows, unsigned cols, StitchMode mode, T restart);
+
+// can the grid of nVertices be drawn with 16-bit indices in this mode; the
+// restart index 0xFFFF must not be a vertex
+bool fitsShortIndices(unsigned nVertices, StitchMode mode);
+
+
+/*
+ * Triangle orders for the post-transform vertex cache.
+ *
+ * The column strips revisit a column of rows + 1 vertices one strip later,
+ * long after a small cache has dropped it. ORDER_BLOCKED cuts the grid into
+ * bands of cacheSize / 2 - 1 rows and walks each band column by column, so
+ * the shared column is still cached. ORDER_FORSYTH is Tom Forsyth's linear
+ * speed optimizer (greedy on a simulated LRU cache with valence boost), which
+ * knows nothing about the grid. Both emit a GL_TRIANGLES list.
+ *
+ * ACMR is cache misses (vertex shader runs) per triangle, ATVR misses per
+ * vertex; measured on a FIFO cache of the given size, the usual model of
+ * the post-transform cache. A grid can't do better than ACMR 0.5.
+ */
+
+enum IndexOrder {
+    ORDER_STRIPS = 0,               // stitched column strips, see stitchGridStrips()
+    ORDER_BLOCKED,                  // cache-width bands of rows, triangle list
+    ORDER_FORSYTH,                  // Forsyth's optimizer over the triangle list
+    nOrder
+};
+
+typedef struct {
+    unsigned triangles;             // not counting degenerate ones
+    unsigned vertices;              // distinct vertices referenced
+    unsigned misses;
+    float    acmr;
+    float    atvr;
+} IndexStats;
+
+const char *indexOrderName(IndexOrder order);
+
+// triangle list of the grid, strip by strip with the strips' winding
+void gridTriangles(std::vector<unsigned> &out, unsigned rows, unsigned cols);
+
+// ORDER_BLOCKED triangle list for a cache of cacheSize vertices
+void blockedGridTriangles(std::vector<unsigned> &out, unsigned rows, unsigned cols, unsigned cacheSize);
+
+// reorder the triangles of list (nVertices vertices) in place. cancelled
+// (may be empty) is polled every few thousand triangles; if it fires list
+// is left as it was
+void optimizeForsyth(std::vector<unsigned> &list, unsigned nVertices, unsigned cacheSize,
+                     const std::function<bool()> &cancelled = std::function<bool()>());
+
+// simulate a FIFO cache of cacheSize over a GL_TRIANGLES list or a
+// GL_TRIANGLE_STRIP (restart indices are skipped, degenerates not counted)
+template <typename T>
+IndexStats analyzeIndices(const std::vector<T> &indices, bool strip, T restart, unsigned cacheSize);
+
+// build the indices of order for the grid into list (a stitched strip for
+// ORDER_STRIPS, triangles otherwise) and return their stats on cacheSize
+IndexStats orderGridIndices(std::vector<unsigned> &list, IndexOrder order, unsigned rows, unsigned cols,
+                            StitchMode stitch, unsigned cacheSize,
+                            const std::function<bool()> &cancelled = std::function<bool()>());
+
+// The single-draw index list of a grid in one order, with its stats and
+// those of the column strips to compare with. rows is 0 while it holds
+// nothing; the list keeps its storage for the next grid.
+struct SingleIndices {
+    std::vector<unsigned> list;
+    unsigned   rows, cols;
+    IndexOrder order;
+    StitchMode stitch;
+    unsigned   cacheSize;
+    IndexStats stats, stripStats;
+
+    SingleIndices() : rows(0), cols(0), order(ORDER_STRIPS), stitch(STITCH_RESTART), cacheSize(0),
+                      stats(), stripStats() {}
+
+    bool matches(unsigned rows, unsigned cols, IndexOrder order, StitchMode stitch, unsigned cacheSize) const;
+};
+
+// fill single for the rows x cols grid; returns false, with single empty,
+// if cancelled (may be empty) fired
+bool orderSingleIndices(SingleIndices *single, unsigned rows, unsigned cols, IndexOrder order, StitchMode stitch,
+                        unsigned cacheSize, const std::function<bool()> &cancelled);
+
+// print ACMR/ATVR and build time of every order on a rows x cols grid for
+// a few cache sizes around cacheSize
+void reportIndexOrders(unsigned rows, unsigned cols, unsigned cacheSize);
+
+#endif //TOWERDEFENSESDL_GRIDINDEX_H
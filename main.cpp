@@ -25,6 +25,225 @@ void drawString(const char *str, int x, int y, float color[4], void *font) {
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// first HUD page: the switches of the wave update and the vertex format
+///////////////////////////////////////////////////////////////////////////////
+void showSettings(float color[4]) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+
+    ss << "Kernel (k): " << waveKernelName(waveKernel) << std::ends;
+    drawString(ss.str().c_str(), 1, screenHeight - (13 * TEXT_HEIGHT), color, font);
+    ss.str("");
+
+    ss << "Evaluation (e): " << waveEvalName(waveEval) << std::ends;
+    drawString(ss.str().c_str(), 1, screenHeight - (15 * TEXT_HEIGHT), color, font);
+    ss.str("");
+
+    // cost of one wave on one vertex, to size scenes with many waves; only
+    // when this frame's update time was spent on the sine waves on the CPU
+    ss << "Waves (+/-): " << nsw << " ";
+    if (updatedVertices && nsw && !OCEAN_MODE)
+        ss << updateTime * 1e6f / ((float) updatedVertices * nsw);
+    else
+        ss << "n/a";
+    ss << " ns/wave/vertex" << std::ends;
+    drawString(ss.str().c_str(), 1, screenHeight - (17 * TEXT_HEIGHT), color, font);
+    ss.str("");
+
+    // the simulation thread drives the pool with --async, its workers'
+    // times are only read through the snapshot published with the frame
+    double maxThreadTime = simulator.isRunning() ? simulator.getMaxThreadTimeInMilliSec()
+                                                 : pool.getMaxThreadTimeInMilliSec();
+    ss << "Threads (t): " << pool.getThreadCount() << " max: " << maxThreadTime << " ms" << std::ends;
+    drawString(ss.str().c_str(), 1, screenHeight - (19 * TEXT_HEIGHT), color, font);
+    ss.str("");
+
+    ss << "Model (g): " << waveModelName(waveModel) << " Q: " << gerstnerSteepness << std::ends;
+    drawString(ss.str().c_str(), 1, screenHeight - (21 * TEXT_HEIGHT), color, font);
+    ss.str("");
+
+    ss << "Ocean (o): " << (OCEAN_MODE ? "ON" : "OFF");
+    if (renMode == TILED_VBO)
+        ss << " not available in TILED_VBO";
+    if (OCEAN_MODE)
+        ss << " FFT " << ocean.getSize() << "x" << ocean.getSize() << " " << ocean.getFFTTimeInMilliSec() << " ms";
+    ss << std::ends;
+    drawString(ss.str().c_str(), 1, screenHeight - (23 * TEXT_HEIGHT), color, font);
+    ss.str("");
+
+    ss << "Trig (n): " << trigTierName(trigTier) << std::ends;
+    drawString(ss.str().c_str(), 1, screenHeight - (25 * TEXT_HEIGHT), color, font);
+    ss.str("");
+
+    ss << "Async (u): " << (ASYNC_UPDATE ? "ON" : "OFF");
+    if (simulator.isRunning())
+        ss << " idle: " << simulator.getIdleTimeInMilliSec() << " ms dropped: " << simulator.getDroppedFrames();
+    ss << std::ends;
+    drawString(ss.str().c_str(), 1, screenHeight - (27 * TEXT_HEIGHT), color, font);
+    ss.str("");
+
+    // bytes the VBO path moves per frame in this format and in the other one
+    unsigned stride = COMPACT_VERTICES ? sizeof(PackedVertex) : sizeof(Vertex);
+    unsigned other = COMPACT_VERTICES ? sizeof(Vertex) : sizeof(PackedVertex);
+    ss << "Format (v): " << (COMPACT_VERTICES ? "COMPACT " : "FULL ") << stride << " B/vertex "
+       << n_vertices * stride / 1024.0f << " KB/frame (" << (COMPACT_VERTICES ? "FULL " : "COMPACT ")
+       << n_vertices * other / 1024.0f << " KB)" << std::ends;
+    drawString(ss.str().c_str(), 1, screenHeight - (29 * TEXT_HEIGHT), color, font);
+    ss.str("");
+
+    ss << "Streams (x): " << (SPLIT_STREAMS ? "SPLIT" : "INTERLEAVED");
+    if (SPLIT_STREAMS && !splitStreams())
+        ss << " (sine model only)";
+    else if (SPLIT_STREAMS)
+        ss << " " << sizeof(HeightSlope) << " B/vertex " << n_vertices * sizeof(HeightSlope) / 1024.0f << " KB/frame";
+    ss << std::ends;
+    drawString(ss.str().c_str(), 1, screenHeight - (31 * TEXT_HEIGHT), color, font);
+    ss.str("");
+
+    ss << "Layout (m): " << (SOA_LAYOUT ? "SOA" : "AOS");
+    if (SOA_LAYOUT && (waveEval != EVAL_DIRECT || waveModel != MODEL_SINE || OCEAN_MODE))
+        ss << " (direct sine only)";
+    ss << std::ends;
+    drawString(ss.str().c_str(), 1, screenHeight - (33 * TEXT_HEIGHT), color, font);
+    ss.str("");
+
+    ss << "Details (h): memory, index order, GPU passes and uploads" << std::ends;
+    drawString(ss.str().c_str(), 1, screenHeight - (35 * TEXT_HEIGHT), color, font);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// second HUD page (h): thread times, memory, index order, GPU passes and
+// uploads. Every line stays within the columns the window shows; the memory
+// breakdowns wrap onto the next line.
+///////////////////////////////////////////////////////////////////////////////
+void showDetails(float color[4]) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    int line = 13;
+    size_t columns = (size_t) (screenWidth / TEXT_WIDTH);
+    auto print = [&]() {
+        ss << std::ends;
+        drawString(ss.str().c_str(), 1, screenHeight - (line * TEXT_HEIGHT), color, font);
+        ss.str("");
+        line += 2;
+    };
+    auto add = [&](const std::string &item) {
+        if (ss.str().size() + item.size() > columns)
+        {
+            print();
+            ss << "    ";
+        }
+        ss << item;
+    };
+
+    // per-thread update time, the first few threads only so it fits
+    ss << std::setprecision(2) << "Per thread (ms):";
+    for (unsigned i = 0; i < pool.getThreadCount() && i < 8; ++i)
+        ss << " " << (simulator.isRunning() ? simulator.getThreadTimeInMilliSec(i) : pool.getThreadTimeInMilliSec(i));
+    if (pool.getThreadCount() > 8)
+        ss << " ...";
+    ss << std::setprecision(3);
+    print();
+
+    ss << "Memory: " << gridReservedBytes() / (1024.0f * 1024.0f) << " MB in " << gridBlockCount()
+       << " blocks, " << gridHugeBytes() / (1024.0f * 1024.0f) << " MB huge pages"
+       << (gridHugePages ? "" : " (off)");
+    print();
+
+    ss << "Index order (i): " << indexOrderName(indexOrder) << " cache " << vertexCacheSize;
+    if (singleIndicesStale)
+        ss << " built when VBO_SINGLE_DRAW draws";
+    else
+        ss << " ACMR " << singleIndices.stats.acmr << " ATVR " << singleIndices.stats.atvr
+           << " (strips " << singleIndices.stripStats.acmr << " / " << singleIndices.stripStats.atvr << ")";
+    print();
+
+    // what each subsystem holds, capacities, in MB; empty ones are left out
+    const float MB = 1024.0f * 1024.0f;
+    auto categories = [&](bool gpu) {
+        for (int i = 0; i < nMem; ++i)
+        {
+            if (memIsGPU((MemCategory) i) != gpu || !memBytes((MemCategory) i))
+                continue;
+            std::stringstream item;
+            item << std::fixed << std::setprecision(1) << " " << memCategoryName((MemCategory) i) << " "
+                 << memBytes((MemCategory) i) / MB;
+            add(item.str());
+        }
+    };
+    ss << std::setprecision(1) << "CPU (b): " << memCPUBytes() / MB << " MB";
+    categories(false);
+    print();
+
+    ss << "GPU: " << memGPUBytes() / MB << " MB";
+    categories(true);
+    if (memBudget)
+    {
+        std::stringstream item;
+        item << std::fixed << std::setprecision(1) << " budget " << (memCPUBytes() + memGPUBytes()) / MB << " / "
+             << memBudget / MB;
+        add(item.str());
+    }
+    ss << std::setprecision(3);
+    print();
+
+    ss << "Passes (j): " << SHADER_PASSES << " feedback (c): " << (TRANSFORM_FEEDBACK ? "ON" : "OFF");
+    if (TRANSFORM_FEEDBACK && !feedbackSupported())
+        ss << " (unsupported)";
+    print();
+
+    // GPU ms as capture + passes x ms per pass; the other path's numbers
+    // are from when it last ran
+    auto passTimes = [&ss](const PassTimer &gpu, unsigned captures) {
+        unsigned n = gpu.getPassCount();
+        if (n <= captures)
+        {
+            ss << " -";
+            return;
+        }
+        double capture = captures ? gpu.getPassTimeInMilliSec(0) : 0;
+        ss << " ";
+        if (captures)
+            ss << capture << " + ";
+        ss << n - captures << " x " << (gpu.getTotalTimeInMilliSec() - capture) / (n - captures)
+           << " = " << gpu.getTotalTimeInMilliSec();
+    };
+    if (PassTimer::isSupported())
+    {
+        ss << "GPU ms: with feedback";
+        passTimes(feedbackTimer, 1);
+        ss << ", without";
+        passTimes(shaderTimer, 0);
+        print();
+    }
+
+    ss << "Upload (r): " << uploadStrategyName(uploader.getStrategy());
+    if (!uploader.isSupported(uploader.getStrategy()))
+        ss << " (unsupported, MAP_READ_WRITE)";
+    ss << " " << uploader.getUploadedBytes() / 1024.0 << " KB/frame";
+    print();
+
+    ss << "Upload time: " << uploader.getUploadTimeInMilliSec() << " ms stalls " << uploader.getStalls() << " ("
+       << uploader.getStallTimeInMilliSec() << " ms)";
+    if (uploader.getRingBytes())
+        ss << " ring " << StreamRing::SEGMENTS << " x " << uploader.getRingBytes() / StreamRing::SEGMENTS / MB << " MB";
+    print();
+
+    ss << "Slices (d): ";
+    if (UPDATE_SLICES > 1)
+        ss << "1 of " << UPDATE_SLICES << " per frame, "
+           << 100.0 * uploader.getUploadedBytes() / ((COMPACT_VERTICES ? sizeof(PackedVertex) : sizeof(Vertex)) * n_vertices)
+           << "% of the VBO uploaded";
+    else
+        ss << "off, whole grid per frame";
+    print();
+
+    ss << "Details (h): on";
+    print();
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // display info messages
 ///////////////////////////////////////////////////////////////////////////////
@@ -42,7 +261,25 @@ void showInfo() {
     float color[4] = {1, 1, 1, 1};
 
     std::stringstream ss;
-    ss << "MODE (SPACE): " << MODE_STRING[(int)renMode] << std::ends;  // add 0(ends) at the end
+    ss << "MODE (SPACE): " << MODE_STRING[(int)renMode];
+    if (renMode == VBO_SINGLE_DRAW)
+        ss << " " << (indexOrder == ORDER_STRIPS ? stitchModeName(stitchMode) : indexOrderName(indexOrder))
+           << " " << singleIndexCount << " x "
+           << (singleIndexType == GL_UNSIGNED_SHORT ? 16 : 32) << "-bit indices, 1 draw call";
+    else if (renMode == TILED_VBO)
+        ss << " " << tiledGrid.getTileCount() << " tiles (draw calls) of " << TiledGrid::TILE_QUADS << "x"
+           << TiledGrid::TILE_QUADS << ", " << tiledGrid.getBufferBytes() / (1024.0f * 1024.0f) << " MB, "
+           << tiledGrid.getIndexCount() << " shared 16-bit indices";
+    else if (renMode == HEIGHTMAP_TEXTURE)
+        ss << " " << (heightmap.isHalf() ? "R16F " : "R32F ") << heightmap.getWidth() << "x" << heightmap.getHeight()
+           << " via " << HeightmapTexture::PBOS << " PBOs, " << heightmap.getUploadedBytes() / 1024.0f << " KB "
+           << heightmap.getUploadTimeInMilliSec() << " ms/frame";
+    else if (renMode == CORE_VAO)
+        ss << " GLSL 3.30 core, 1 VAO, " << cols << " draw calls, " << coreRenderer.getRespecifications()
+           << " attribute re-specifications";
+    else if (renMode >= STORE_ARRAY_INDICE)
+        ss << " " << cols << " draw calls";
+    ss << std::ends;  // add 0(ends) at the end
     drawString(ss.str().c_str(), 1, screenHeight - TEXT_HEIGHT, color, font);
     ss.str(""); // clear buffer
 
@@ -63,12 +300,29 @@ void showInfo() {
     drawString(ss.str().c_str(), 1, screenHeight - (9 * TEXT_HEIGHT), color, font);
     ss.str("");
 
-    ss << "Drawing: " << "row: " << rows << " col: " << cols << " Vertices: " << n_vertices << std::ends;
+    ss << "Drawing: " << "row: " << rows << " col: " << cols << " Vertices: "
+       << (renMode == TILED_VBO ? tiledGrid.getVertexCount() : (uint64_t) n_vertices);
+    if (renMode == TILED_VBO)
+        ss << " tile build " << tiledGrid.getBuildTimeInMilliSec() << " ms";
+    else if (gridBuilder.isBusy())
+        ss << " building " << nextRows << "x" << nextCols;
+    else if (gridBuilder.getBuildTimeInMilliSec() > 0)
+        ss << " last build " << gridBuilder.getBuildTimeInMilliSec() << " ms";
+    if (gridBuilder.getCancelledBuilds())
+        ss << " cancelled " << gridBuilder.getCancelledBuilds();
+    if (gridBuilder.getFailedBuilds())
+        ss << " failed " << gridBuilder.getFailedBuilds();
+    ss << std::ends;
     drawString(ss.str().c_str(), 1, screenHeight - (11 * TEXT_HEIGHT), color, font);
     ss.str("");
 
+    if (HUD_DETAILS)
+        showDetails(color);
+    else
+        showSettings(color);
+
     ss << "Use ARROW to change rows and cols" << std::ends;
-    drawString(ss.str().c_str(), 1, screenHeight - (13 * TEXT_HEIGHT), color, font);
+    drawString(ss.str().c_str(), 1, screenHeight - (37 * TEXT_HEIGHT), color, font);
 
     ss << "Press SPACE key to toggle between Mode" << std::ends;
     drawString(ss.str().c_str(), 1, 1, color, font);
@@ -150,14 +404,168 @@ void unbindVBOs() {
     glBindBuffer(0, ibo);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// report what the grid arrays, the tiles and their buffer objects hold
+///////////////////////////////////////////////////////////////////////////////
+void accountMemory() {
+    memSet(MEM_GRID, (size_t) vertexCapacity * sizeof(Vertex) + (size_t) indexCapacity * sizeof(unsigned));
+    memSet(MEM_BUILDER, gridBuilder.getHeldBytes());
+    memSet(MEM_SOA, (size_t) soa.capacity * 4 * sizeof(float));
+    memSet(MEM_VBO, vboBytes);
+    memSet(MEM_IBO, iboBytes + iboSingleBytes);
+    memSet(MEM_STREAMS, vboStaticBytes + vboDynamicBytes);
+    memSet(MEM_RING, uploader.getRingBytes());
+    memSet(MEM_TILE_BUFFERS, tiledGrid.getBufferBytes());
+    memSet(MEM_HEIGHTMAP, heightmap.getBytes());
+    memSet(MEM_FEEDBACK, vboFeedbackBytes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the capacity a grow-only array or buffer of capacity ends up with once it
+// has to hold needed
+///////////////////////////////////////////////////////////////////////////////
+static size_t grownCapacity(size_t capacity, size_t needed) {
+    return needed <= capacity ? capacity : gridGrowCapacity(capacity, needed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// estimated bytes in MEM_GRID..MEM_STREAMS with a rows x cols grid, in the
+// current vertex format and index order, at the capacities the arrays and
+// buffers will have. Built in place the current arrays grow; built in the
+// background the builder's spare set grows while the current arrays are
+// still drawn, and those stay with the builder afterwards, so both count.
+///////////////////////////////////////////////////////////////////////////////
+size_t gridMemory(unsigned rows, unsigned cols, bool background) {
+    size_t n = ((size_t) rows + 1) * ((size_t) cols + 1);
+    size_t cpu;
+    if (background)
+    {
+        unsigned spareVertices, spareIndices;
+        gridBuilder.getSpareCapacity(&spareVertices, &spareIndices);
+        // an oversized spare set is freed before the build, see GridBuilder
+        if (spareVertices > gridGrowCapacity(n, n) || spareIndices > gridGrowCapacity(2 * n, 2 * n))
+            spareVertices = spareIndices = 0;
+        cpu = memBytes(MEM_GRID) + grownCapacity(spareVertices, n) * sizeof(Vertex)
+              + grownCapacity(spareIndices, 2 * n) * sizeof(unsigned);
+    }
+    else
+    {
+        cpu = gridBuilder.getHeldBytes() + grownCapacity(vertexCapacity, n) * sizeof(Vertex)
+              + grownCapacity(indexCapacity, 2 * n) * sizeof(unsigned);
+    }
+    cpu += grownCapacity(soa.capacity, n) * 4 * sizeof(float);
+
+    size_t gpu = grownCapacity(vboBytes, n * (COMPACT_VERTICES ? sizeof(PackedVertex) : sizeof(Vertex)))
+                 + grownCapacity(iboBytes, 2 * n * sizeof(unsigned))
+                 + grownCapacity(vboStaticBytes, n * sizeof(StaticXZ))
+                 + grownCapacity(vboDynamicBytes, n * sizeof(HeightSlope));
+    // single draw: about 2 indices per vertex as strips, 6 as triangles
+    gpu += grownCapacity(iboSingleBytes, n * (indexOrder == ORDER_STRIPS ? 2 : 6)
+                                         * (n < 0xFFFF ? sizeof(unsigned short) : sizeof(unsigned)));
+    return cpu + gpu;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bytes of rows x cols as tiles in MEM_TILE_BUFFERS
+///////////////////////////////////////////////////////////////////////////////
+size_t tileMemory(unsigned rows, unsigned cols) {
+    size_t tiles = (((size_t) rows + TiledGrid::TILE_QUADS - 1) / TiledGrid::TILE_QUADS)
+                   * (((size_t) cols + TiledGrid::TILE_QUADS - 1) / TiledGrid::TILE_QUADS);
+    size_t indices = (size_t) TiledGrid::TILE_QUADS * TiledGrid::TILE_QUADS * 6 * sizeof(unsigned short);
+    return tiles * TiledGrid::TILE_VERTICES * sizeof(Vertex) + indices;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// put bytes of data into a buffer object. The name is created once and the
+// storage only grows; whatever fits is orphaned (so the driver can hand out
+// fresh memory if the GPU still reads the old frame) and rewritten in place.
+///////////////////////////////////////////////////////////////////////////////
+static void fillBuffer(GLenum target, unsigned *id, size_t *capacity, size_t bytes, const void *data, GLenum usage)
+{
+    if (!*id)
+        glGenBuffers(1, id);
+    glBindBuffer(target, *id);
+    if (bytes > *capacity)
+        *capacity = gridGrowCapacity(*capacity, bytes);
+    glBufferData(target, *capacity, NULL, usage);
+    glBufferSubData(target, 0, bytes, data);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the index buffer of VBO_SINGLE_DRAW in the current order, 16-bit when
+// every index (and the restart index of stitched strips) fits. Ordering a
+// large grid takes long, so this only runs when VBO_SINGLE_DRAW draws with
+// stale indices, see singleIndicesStale, and orders only if gridBuilder did
+// not already do it for this grid.
+///////////////////////////////////////////////////////////////////////////////
+void buildSingleIndices() {
+    static std::vector<unsigned short> shortList;
+    const std::vector<unsigned> &list = singleIndices.list;
+
+    // the arrays' own size: in TILED_VBO rows/cols belong to the tiles
+    if (!singleIndices.matches(grid.rows, grid.cols, indexOrder, stitchMode, vertexCacheSize))
+        orderSingleIndices(&singleIndices, grid.rows, grid.cols, indexOrder, stitchMode, vertexCacheSize,
+                           std::function<bool()>());
+    singlePrimitive = indexOrder == ORDER_STRIPS ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+    singleIndexCount = (unsigned) list.size();
+
+    bool restart = indexOrder == ORDER_STRIPS && stitchMode == STITCH_RESTART;
+    if (fitsShortIndices(n_vertices, restart ? STITCH_RESTART : STITCH_DEGENERATE))
+    {
+        shortList.resize(list.size());
+        for (size_t i = 0; i < list.size(); ++i)
+            shortList[i] = (unsigned short) list[i];        // the restart index becomes 0xFFFF
+        singleIndexType = GL_UNSIGNED_SHORT;
+        fillBuffer(GL_ELEMENT_ARRAY_BUFFER, &iboSingle, &iboSingleBytes, shortList.size() * sizeof(unsigned short),
+                   shortList.data(), GL_STATIC_DRAW);
+    }
+    else
+    {
+        singleIndexType = GL_UNSIGNED_INT;
+        fillBuffer(GL_ELEMENT_ARRAY_BUFFER, &iboSingle, &iboSingleBytes, list.size() * sizeof(unsigned),
+                   list.data(), GL_STATIC_DRAW);
+    }
+    singleIndicesStale = false;
+    accountMemory();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// upload the current grid, reusing the buffer objects of the previous one
+///////////////////////////////////////////////////////////////////////////////
 void buildVBOs() {
-    glGenBuffers(1, &vbo); //buffer for vertex
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, n_vertices * sizeof(Vertex), vertices, GL_DYNAMIC_DRAW);
+    // staging copies keep their storage between resizes too
+    static std::vector<PackedVertex> packed;
+    static std::vector<StaticXZ> xz;
+    static std::vector<HeightSlope> hs;
+
+    const void *data = vertices;
+    size_t bytes = n_vertices * sizeof(Vertex);
+    if (COMPACT_VERTICES)
+    {
+        packed.resize(n_vertices);
+        packVertices(packed.data(), vertices, 0, n_vertices);
+        data = packed.data();
+        bytes = n_vertices * sizeof(PackedVertex);
+    }
+    fillBuffer(GL_ARRAY_BUFFER, &vbo, &vboBytes, bytes, data, GL_DYNAMIC_DRAW);
 
-    glGenBuffers(1, &ibo); //buffer for indice
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, n_indices * sizeof(unsigned int), indices, GL_DYNAMIC_DRAW);
+    // a persistent ring starts with the same vertices in every segment
+    uploader.reset(vbo, vboBytes, bytes, data);
+
+    // split streams: x/z uploaded once, height and slope rewritten every frame
+    xz.resize(n_vertices);
+    gatherStaticXZ(xz.data(), vertices, 0, n_vertices);
+    fillBuffer(GL_ARRAY_BUFFER, &vboStatic, &vboStaticBytes, n_vertices * sizeof(StaticXZ), xz.data(), GL_STATIC_DRAW);
+
+    hs.resize(n_vertices);
+    gatherHeightSlope(hs.data(), vertices, 0, n_vertices);
+    fillBuffer(GL_ARRAY_BUFFER, &vboDynamic, &vboDynamicBytes, n_vertices * sizeof(HeightSlope), hs.data(), GL_STREAM_DRAW);
+
+    fillBuffer(GL_ELEMENT_ARRAY_BUFFER, &ibo, &iboBytes, n_indices * sizeof(unsigned int), indices, GL_DYNAMIC_DRAW);
+    singleIndicesStale = true;  // ordered the next time VBO_SINGLE_DRAW draws
+    accountMemory();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 void enableVBOs() {
@@ -175,11 +583,45 @@ void calcSineWave3D(sinewave wave, float x, float z, double t, float *y, bool de
     float angle = wave.k * x * x + wave.k * z * z + wave.w * t;
 //    float angle = wave.k * z * z  + wave.w * t;
 
-    *y = wave.A * sinf(angle);
+    *y = wave.A * trigSin(angle);
     if (der) {
-        *dydx = wave.k * wave.A * cosf(angle);
+        *dydx = wave.k * wave.A * trigCos(angle);
+    }
+}
+
+// sum of all nsw waves in sws[]
+void calcSineWaves3D(float x, float z, double t, float *y, bool der, float *dydx) {
+    float wy, wdydx = 0;
+    *y = 0;
+    if (der)
+        *dydx = 0;
+    for (int i = 0; i < nsw; i++) {
+        calcSineWave3D(sws[i], x, z, t, &wy, der, &wdydx);
+        *y += wy;
+        if (der)
+            *dydx += wdydx;
     }
 }
+
+float rand01();
+
+///////////////////////////////////////////////////////////////////////////////
+// add a random wave to sws[], or remove the last one
+///////////////////////////////////////////////////////////////////////////////
+void addWave() {
+    if (nsw >= MAX_WAVES)
+        return;
+    sinewave wave;
+    wave.A = 0.02f + 0.08f * rand01();
+    wave.k = (0.5f + 3.5f * rand01()) * M_PI;
+    wave.w = (0.25f + 0.75f * rand01()) * M_PI;
+    sws[nsw++] = wave;
+}
+
+void removeWave() {
+    if (nsw > 0)
+        nsw--;
+}
 void drawGrid2D(int rows, int cols) {
     glPushAttrib(GL_CURRENT_BIT);
     glPolygonMode(GL_FRONT_AND_BACK, fillMode == LINE ? GL_LINE : GL_FILL);
@@ -198,7 +640,7 @@ void drawGrid2D(int rows, int cols) {
             float z = -1.0 + j * dy;
             float y;
 
-            calcSineWave3D(sws[0], x, z, timer.getElapsedTime(), &y, true, &dydx);
+            calcSineWaves3D(x, z, timer.getElapsedTime(), &y, true, &dydx);
             ny = dydx;
             nx = 1.0;
             nz = 0;
@@ -206,7 +648,7 @@ void drawGrid2D(int rows, int cols) {
             glNormal3f(-ny,nx,nz);
             glVertex3f(x, y, z);
 
-            calcSineWave3D(sws[0], x+dx, z, timer.getElapsedTime(), &y, true, &dydx);
+            calcSineWaves3D(x+dx, z, timer.getElapsedTime(), &y, true, &dydx);
             ny = dydx;
             nx = 1.0;
             nz = 0;
@@ -293,70 +735,185 @@ glm::vec3 computeLighting(glm::vec3 & rEC, glm::vec3 & nEC)
     return color;
 }
 
-void computeAndStoreGrid2D(int rows, int cols) {
-    n_vertices = (rows + 1) * (cols + 1);
-    n_indices = n_vertices * 2;
-    // or more simply: n_indices = n_vertices * 2;
-    free(vertices);
-    vertices = (Vertex *) malloc(n_vertices * sizeof(Vertex));
-    free(indices);
-    indices = (unsigned *) malloc(n_indices * sizeof(unsigned));
+///////////////////////////////////////////////////////////////////////////////
+// the vertex/index globals as one GridArrays and back
+///////////////////////////////////////////////////////////////////////////////
+static GridArrays currentGrid()
+{
+    GridArrays arrays = {vertices, indices, n_vertices, n_indices, vertexCapacity, indexCapacity, grid};
+    return arrays;
+}
 
+static void setCurrentGrid(const GridArrays &arrays)
+{
+    vertices = arrays.vertices;
+    indices = arrays.indices;
+    n_vertices = arrays.nVertices;
+    n_indices = arrays.nIndices;
+    vertexCapacity = arrays.vertexCapacity;
+    indexCapacity = arrays.indexCapacity;
+    grid = arrays.grid;
+    rows = grid.rows;
+    cols = grid.cols;
+    resetWaveRecurrence();
+    loadWaveSoA(&soa, vertices, n_vertices);
+    accountMemory();
+}
 
-    float nx,ny,nz;
-    float dydx;
+void setRenderMode(RenderMode mode);
 
-    /* Grid */
+///////////////////////////////////////////////////////////////////////////////
+// build the tiles of TILED_VBO for rows x cols. Over the budget the tiles
+// keep their size; if there are none yet, or memory runs out, the mode is
+// left.
+///////////////////////////////////////////////////////////////////////////////
+void buildTiles()
+{
+    if (!memFits(MEM_TILE_BUFFERS, MEM_TILE_BUFFERS, tileMemory(rows, cols)))
+    {
+        fprintf(stderr, "a %u x %u tiled grid needs %.1f MB, over the memory budget\n", rows, cols,
+                tileMemory(rows, cols) / (1024.0 * 1024.0));
+        if (tiledGrid.getTileCount())
+        {
+            rows = nextRows = tiledGrid.getRows();
+            cols = nextCols = tiledGrid.getCols();
+            return;
+        }
+    }
+    else if (tiledGrid.build(rows, cols, sws, nsw, timer.getElapsedTime(), vertexCacheSize, pool))
+    {
+        accountMemory();
+        return;
+    }
+    else
+    {
+        fprintf(stderr, "out of memory for the %u x %u tiled grid\n", rows, cols);
+    }
+    accountMemory();
+    setRenderMode(VERTEX_BUFFER_OBJECT);
+}
 
-    /* Vertices */
-    float dy = 2/ (float) rows;
-    float dx = 2 / (float) cols;
-    Vertex *vtx = vertices;
-    for (int i = 0; i <= cols; i++) {
-        float x = -1.0 + i * dx;
-        for (int j = 0; j <= rows; j++) {
-            float z = -1.0 + j * dy;
-            float y;
-            calcSineWave3D(sws[0], x, z, timer.getElapsedTime(), &y, true, &dydx);
-            ny = dydx;
-            nx = 1.0;
-            nz = 0;
+///////////////////////////////////////////////////////////////////////////////
+// rebuild the grid now on this thread. A resize still building in the
+// background is dropped, callers pass the size it was going to have.
+// In TILED_VBO this rebuilds the tiles. A size over the memory budget or
+// too large for the one-piece arrays keeps the grid there is, or falls back
+// to the default 50 x 50 if there is none.
+///////////////////////////////////////////////////////////////////////////////
+void computeAndStoreGrid2D(int rows, int cols) {
+    gridBuilder.cancel();
+    nextRows = rows;
+    nextCols = cols;
 
-            vtx->r =  {x, y, z};
-            vtx->n = {-ny,nx,nz};
+    if (renMode == TILED_VBO)
+    {
+        ::rows = rows;
+        ::cols = cols;
+        buildTiles();
+        return;
+    }
 
-            printf("(%5.2f,%5.2f, %5.2f)", vtx->r.x, vtx->r.y, vtx->r.z);
+    GridArrays arrays = currentGrid();
+    if (!memFits(MEM_GRID, MEM_STREAMS, gridMemory(rows, cols, false)))
+    {
+        fprintf(stderr, "a %d x %d grid needs %.1f MB, over the memory budget\n", rows, cols,
+                gridMemory(rows, cols, false) / (1024.0 * 1024.0));
+    }
+    else if (buildGridArrays(&arrays, rows, cols, sws, nsw, timer.getElapsedTime(), trigTier, nullptr))
+    {
+        setCurrentGrid(arrays);
+        return;
+    }
+    else
+    {
+        fprintf(stderr, "no room for a %d x %d grid in one piece, use TILED_VBO (7)\n", rows, cols);
+    }
 
-            vtx++;
-        }
-        printf("\n");
+    // out of memory frees the arrays
+    if (!arrays.vertices)
+        buildGridArrays(&arrays, 50, 50, sws, nsw, timer.getElapsedTime(), trigTier, nullptr);
+    setCurrentGrid(arrays);
+    nextRows = ::rows;
+    nextCols = ::cols;
+}
 
+///////////////////////////////////////////////////////////////////////////////
+// start building nextRows x nextCols in the background; the old grid is
+// drawn until acceptGrid() picks the new one up. Tiles are built at once,
+// on the pool.
+///////////////////////////////////////////////////////////////////////////////
+void requestGrid()
+{
+    if (renMode == TILED_VBO)
+    {
+        computeAndStoreGrid2D(nextRows, nextCols);
+    }
+    else if (!memFits(MEM_GRID, MEM_STREAMS, gridMemory(nextRows, nextCols, true)))
+    {
+        fprintf(stderr, "a %u x %u grid needs %.1f MB, over the memory budget\n", nextRows, nextCols,
+                gridMemory(nextRows, nextCols, true) / (1024.0 * 1024.0));
+        nextRows = rows;
+        nextCols = cols;
+    }
+    else
+    {
+        gridBuilder.setIndexOrder(renMode == VBO_SINGLE_DRAW, indexOrder, stitchMode, vertexCacheSize);
+        gridBuilder.request(nextRows, nextCols, sws, nsw, timer.getElapsedTime());
     }
-    printf("\n");
-    printf("\n");
-    printf("\n");
+}
 
-    /* Indices */
-    unsigned *idx = indices;
-    for (int i = 0; i < cols; i++) {
-        for (int j = 0; j <= rows; j++) {
-            *idx++ = i * (rows + 1) + j;
-            *idx++ = (i + 1) * (rows + 1) + j;
-        }
+///////////////////////////////////////////////////////////////////////////////
+// switch the render mode. The tiles are freed when TILED_VBO is left, and
+// the one-piece arrays are brought to the size the tiles had. The height
+// texture goes when HEIGHTMAP_TEXTURE is left. The FFT ocean needs the grid
+// in one piece, so TILED_VBO is refused while it is on.
+///////////////////////////////////////////////////////////////////////////////
+void setRenderMode(RenderMode mode)
+{
+    if (mode == TILED_VBO && OCEAN_MODE)
+    {
+        fprintf(stderr, "no TILED_VBO with the FFT ocean on, turn it off with o first\n");
+        return;
     }
 
-    for (int i = 0; i <= cols; i++) {
-        for (int j = 0; j <= rows; j++) {
-            int idx = i * (rows + 1) + j;
-            printf("(%5.2f,%5.2f, %5.2f)", vertices[idx].r.x, vertices[idx].r.y, vertices[idx].r.z);
-        }
-        printf("\n");
+    if (renMode == HEIGHTMAP_TEXTURE && mode != HEIGHTMAP_TEXTURE)
+    {
+        heightmap.release();
+        accountMemory();
     }
-    for (int i = 0; i < n_indices; i++) {
-        printf("%d ", indices[i]);
+
+    bool leaving = renMode == TILED_VBO && mode != TILED_VBO;
+    renMode = mode;
+    if (!leaving)
+        return;
+
+    tiledGrid.release();
+    accountMemory();
+    if (grid.rows != rows || grid.cols != cols)
+    {
+        computeAndStoreGrid2D(rows, cols);
+        buildVBOs();
     }
-    printf("\n");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// once per frame: swap in a finished background grid and upload it. The
+// builder prepared everything else, the single-draw indices included.
+///////////////////////////////////////////////////////////////////////////////
+void acceptGrid()
+{
+    // the builder's arrays grow and are freed on its own thread
+    memSet(MEM_BUILDER, gridBuilder.getHeldBytes());
+    if (!gridBuilder.isReady())
+        return;
 
+    // the simulation thread reads the old arrays, which take() may free
+    simulator.stop();
+    GridArrays arrays = currentGrid();
+    if (!gridBuilder.take(&arrays, &singleIndices))
+        return;
+    setCurrentGrid(arrays);
+    buildVBOs();
 }
 
 void drawGrid2DStoredVertices(int rows, int cols) {
@@ -425,113 +982,522 @@ void drawGrid2DStoredVerticesAndIndices(int rows, int cols) {
 
 
 
-            idx++;
+            idx++;
+
+            glNormal3fv(&vertices[*idx].n.x);
+            glVertex3fv(&vertices[*idx].r.x);
+            idx++;
+        }
+        glEnd();
+    }
+
+    glPopAttrib();
+}
+void drawGrid2DVAs(int rows, int cols) {
+    glPushAttrib(GL_CURRENT_BIT);
+    glPolygonMode(GL_FRONT_AND_BACK, fillMode == LINE ? GL_LINE : GL_FILL);
+    glColor3f(1.0, 1.0, 1.0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glVertexPointer(3, GL_FLOAT, sizeof(Vertex), &vertices[0].r);
+    glNormalPointer(GL_FLOAT, sizeof(Vertex), &vertices[0].n);
+
+    for (int i = 0; i < cols; i++)
+        glDrawElements(GL_TRIANGLE_STRIP, (rows + 1) * 2, GL_UNSIGNED_INT, &indices[i * (rows + 1) * 2]);
+
+    glPopAttrib();
+}
+///////////////////////////////////////////////////////////////////////////////
+// draw the grid from the buffers already set up: one glDrawElements per
+// column strip, or in VBO_SINGLE_DRAW the stitched list in one call
+///////////////////////////////////////////////////////////////////////////////
+void drawGridElements(int rows, int cols) {
+    if (renMode == VBO_SINGLE_DRAW)
+    {
+        if (singleIndicesStale)
+            buildSingleIndices();
+        bool restart = singlePrimitive == GL_TRIANGLE_STRIP && stitchMode == STITCH_RESTART;
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboSingle);
+        if (restart)
+        {
+            glEnable(GL_PRIMITIVE_RESTART);
+            glPrimitiveRestartIndex(singleIndexType == GL_UNSIGNED_SHORT ? 0xFFFF : 0xFFFFFFFF);
+        }
+        glDrawElements(singlePrimitive, singleIndexCount, singleIndexType, BUFFER_OFFSET(0));
+        if (restart)
+            glDisable(GL_PRIMITIVE_RESTART);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        return;
+    }
+
+    for (int i = 0; i < cols; i++) {
+        glDrawElements(GL_TRIANGLE_STRIP, (rows + 1) * 2, GL_UNSIGNED_INT,
+                       BUFFER_OFFSET(i * (rows + 1) * 2 * sizeof(unsigned int)));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the split streams carry (y, n.x) only, which is all the sine model changes
+///////////////////////////////////////////////////////////////////////////////
+bool splitStreams() {
+    return SPLIT_STREAMS && streamProgram && waveModel == MODEL_SINE && !OCEAN_MODE;
+}
+
+void drawGrid2DStreams(int rows, int cols) {
+    glPushAttrib(GL_CURRENT_BIT);
+    glPolygonMode(GL_FRONT_AND_BACK, fillMode == LINE ? GL_LINE : GL_FILL);
+    glColor3f(1.0, 1.0, 1.0);
+
+    // StaticXZ is bound to location 0 when the program is loaded
+    GLint hs = glGetAttribLocation(streamProgram, "HeightSlope");
+    glUseProgram(streamProgram);
+    glBindBuffer(GL_ARRAY_BUFFER, vboStatic);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(StaticXZ), BUFFER_OFFSET(0));
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, vboDynamic);
+    glVertexAttribPointer(hs, 2, GL_FLOAT, GL_FALSE, sizeof(HeightSlope), BUFFER_OFFSET(0));
+    glEnableVertexAttribArray(hs);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+    drawGridElements(rows, cols);
+
+    glDisableVertexAttribArray(hs);
+    glDisableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glUseProgram(USE_SHADER ? program : 0);
+    glPopAttrib();
+}
+
+void updateVerticesParallel(Vertex *dst, const Vertex *src, unsigned count, float time);
+
+///////////////////////////////////////////////////////////////////////////////
+// (re)create the height texture for the current grid. Without GL 3.0, a
+// vertex texture unit or the shader, or past the texture size limit, the
+// mode falls back to VERTEX_BUFFER_OBJECT.
+///////////////////////////////////////////////////////////////////////////////
+bool buildHeightmap() {
+    if (heightmapProgram && HeightmapTexture::isSupported() &&
+        heightmap.create(grid.rows, grid.cols, COMPACT_VERTICES, vertices))
+    {
+        accountMemory();
+        return true;
+    }
+
+    fprintf(stderr, "no height texture for a %u x %u grid, back to VERTEX_BUFFER_OBJECT\n", grid.rows, grid.cols);
+    setRenderMode(VERTEX_BUFFER_OBJECT);
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// update the CPU copy, then stream just its heights into the next pixel
+// buffer, band by band on the pool
+///////////////////////////////////////////////////////////////////////////////
+void uploadHeights(float time) {
+    updateVerticesParallel(vertices, vertices, n_vertices, time);
+
+    void *dst = heightmap.begin();
+    if (!dst)
+        return;
+    bool half = heightmap.isHalf();
+    pool.run(n_vertices, VERTEX_BAND_ALIGN, [=](unsigned begin, unsigned end) {
+        if (half)
+            gatherHalfHeights((unsigned short *)dst, vertices, begin, end);
+        else
+            gatherHeights((float *)dst, vertices, begin, end);
+    });
+    heightmap.end();
+}
+
+void drawGrid2DHeightmap(int rows, int cols) {
+    glPushAttrib(GL_CURRENT_BIT);
+    glPolygonMode(GL_FRONT_AND_BACK, fillMode == LINE ? GL_LINE : GL_FILL);
+    glColor3f(1.0, 1.0, 1.0);
+
+    glUseProgram(heightmapProgram);
+    glUniform1i(glGetUniformLocation(heightmapProgram, "Heightmap"), 0);
+    glUniform2f(glGetUniformLocation(heightmapProgram, "GridOrigin"), grid.x0, grid.z0);
+    glUniform2f(glGetUniformLocation(heightmapProgram, "GridStep"), grid.dx, grid.dz);
+    glUniform2f(glGetUniformLocation(heightmapProgram, "TexelSize"),
+                1.0f / heightmap.getWidth(), 1.0f / heightmap.getHeight());
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, heightmap.getTexture());
+
+    // StaticXZ is bound to location 0 when the program is loaded
+    glBindBuffer(GL_ARRAY_BUFFER, vboStatic);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(StaticXZ), BUFFER_OFFSET(0));
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+    drawGridElements(rows, cols);
+
+    glDisableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(USE_SHADER ? program : 0);
+    glPopAttrib();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// draw the vertices at offset in buffer, vbo or a segment of the ring
+///////////////////////////////////////////////////////////////////////////////
+void drawGrid2DVBOs(int rows, int cols, unsigned buffer, size_t offset) {
+    glPushAttrib(GL_CURRENT_BIT);
+    glPolygonMode(GL_FRONT_AND_BACK, fillMode == LINE ? GL_LINE : GL_FILL);
+    glColor3f(1.0, 1.0, 1.0);
+
+    bindVBOs();
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (COMPACT_VERTICES)
+    {
+        // fixed point positions, scaled back by the modelview matrix; that
+        // scales the normals too, so let GL renormalize them
+        glPushAttrib(GL_ENABLE_BIT);
+        glEnable(GL_NORMALIZE);
+        glPushMatrix();
+        glScalef(PACKED_POSITION_SCALE, PACKED_POSITION_SCALE, PACKED_POSITION_SCALE);
+        glVertexPointer(3, GL_SHORT, sizeof(PackedVertex), BUFFER_OFFSET(offset));
+        glNormalPointer(packedNormal1010102 ? GL_INT_2_10_10_10_REV : GL_BYTE, sizeof(PackedVertex),
+                        BUFFER_OFFSET(offset + offsetof(PackedVertex, n)));
+    }
+    else
+    {
+        glVertexPointer(3, GL_FLOAT, sizeof(Vertex), BUFFER_OFFSET(offset));
+        glNormalPointer(GL_FLOAT, sizeof(Vertex), BUFFER_OFFSET(offset + sizeof(vec3f)));
+    }
+
+    /* Grid */
+    drawGridElements(rows, cols);
+
+    if (COMPACT_VERTICES)
+    {
+        glPopMatrix();
+        glPopAttrib();
+    }
+    unbindVBOs();
+    glPopAttrib();
+}
+
+void setWaveUniforms(GLuint program);
+
+///////////////////////////////////////////////////////////////////////////////
+// transform feedback: evaluate the waves once for the vertices at offset in
+// buffer and capture position and normal into vboFeedback, in vertex order,
+// so the index buffers draw the capture the way they draw the VBO
+///////////////////////////////////////////////////////////////////////////////
+void captureWaves(unsigned buffer, size_t offset) {
+    size_t bytes = (size_t) n_vertices * FEEDBACK_STRIDE;
+    if (!vboFeedback)
+        glGenBuffers(1, &vboFeedback);
+    if (bytes > vboFeedbackBytes)
+    {
+        vboFeedbackBytes = gridGrowCapacity(vboFeedbackBytes, bytes);
+        glBindBuffer(GL_ARRAY_BUFFER, vboFeedback);
+        glBufferData(GL_ARRAY_BUFFER, vboFeedbackBytes, NULL, GL_DYNAMIC_COPY);
+        accountMemory();
+    }
+
+    glUseProgram(feedbackProgram);
+    setWaveUniforms(feedbackProgram);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (COMPACT_VERTICES)
+        glVertexPointer(3, GL_SHORT, sizeof(PackedVertex), BUFFER_OFFSET(offset));
+    else
+        glVertexPointer(3, GL_FLOAT, sizeof(Vertex), BUFFER_OFFSET(offset));
+    // points only read positions
+    glDisableClientState(GL_NORMAL_ARRAY);
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vboFeedback);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, n_vertices);
+    glEndTransformFeedback();
+    glDisable(GL_RASTERIZER_DISCARD);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void drawGrid2DFeedback(int rows, int cols) {
+    glPushAttrib(GL_CURRENT_BIT);
+    glPolygonMode(GL_FRONT_AND_BACK, fillMode == LINE ? GL_LINE : GL_FILL);
+    glColor3f(1.0, 1.0, 1.0);
+
+    glUseProgram(litProgram);
+    glBindBuffer(GL_ARRAY_BUFFER, vboFeedback);
+    glVertexPointer(3, GL_FLOAT, FEEDBACK_STRIDE, BUFFER_OFFSET(0));
+    glNormalPointer(GL_FLOAT, FEEDBACK_STRIDE, BUFFER_OFFSET(3 * sizeof(float)));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+
+    drawGridElements(rows, cols);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glPopAttrib();
+}
+
+bool feedbackSupported() {
+    return feedbackProgram && litProgram && GLEW_VERSION_3_0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the shader path: SHADER_PASSES draws of the grid, standing in for the
+// passes of multi-pass rendering, each timed on the GPU. With
+// TRANSFORM_FEEDBACK the waves are captured once and the passes draw the
+// capture; without, every pass evaluates the waves again.
+///////////////////////////////////////////////////////////////////////////////
+void drawShaderPasses(int rows, int cols, unsigned buffer, size_t offset) {
+    bool feedback = TRANSFORM_FEEDBACK && feedbackSupported();
+    bool timed = PassTimer::isSupported();
+    PassTimer &gpu = feedback ? feedbackTimer : shaderTimer;
+
+    if (timed)
+        gpu.beginFrame();
+    if (feedback)
+    {
+        if (timed)
+            gpu.begin();
+        captureWaves(buffer, offset);
+        if (timed)
+            gpu.end();
+    }
+    for (unsigned pass = 0; pass < SHADER_PASSES; ++pass)
+    {
+        if (timed)
+            gpu.begin();
+        if (feedback)
+            drawGrid2DFeedback(rows, cols);
+        else
+            drawGrid2DVBOs(rows, cols, buffer, offset);
+        if (timed)
+            gpu.end();
+    }
+    glUseProgram(program);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// set up the vertex array of CORE_VAO. Without GL 3.3 or the core shaders
+// the mode falls back to VERTEX_BUFFER_OBJECT.
+///////////////////////////////////////////////////////////////////////////////
+bool buildCore() {
+    if (CoreRenderer::isSupported() && coreRenderer.create(coreProgram))
+        return true;
+
+    fprintf(stderr, "no GL 3.3 core renderer, back to VERTEX_BUFFER_OBJECT\n");
+    setRenderMode(VERTEX_BUFFER_OBJECT);
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the vertices at offset in buffer through the vertex array: one bind, the
+// glm matrices of display() as uniforms, the waves on the GPU with the shader
+///////////////////////////////////////////////////////////////////////////////
+void drawGrid2DCore(int rows, int cols, unsigned buffer, size_t offset) {
+    coreRenderer.setVertices(buffer, offset, COMPACT_VERTICES, packedNormal1010102, ibo);
+    coreRenderer.begin(modelViewMatrix, projectionMatrix, normalMatrix,
+                       COMPACT_VERTICES ? PACKED_POSITION_SCALE : 1.0f);
+    coreRenderer.setWaves(USE_SHADER, (float)timer.getElapsedTime(), sws,
+                          nsw < MAX_SHADER_WAVES ? nsw : MAX_SHADER_WAVES);
+    glPolygonMode(GL_FRONT_AND_BACK, fillMode == LINE ? GL_LINE : GL_FILL);
 
-            glNormal3fv(&vertices[*idx].n.x);
-            glVertex3fv(&vertices[*idx].r.x);
-            idx++;
-        }
-        glEnd();
-    }
+    drawGridElements(rows, cols);
 
-    glPopAttrib();
+    coreRenderer.end();
+    glUseProgram(USE_SHADER ? program : 0);
 }
-void drawGrid2DVAs(int rows, int cols) {
+
+void drawGrid2DTiles() {
     glPushAttrib(GL_CURRENT_BIT);
     glPolygonMode(GL_FRONT_AND_BACK, fillMode == LINE ? GL_LINE : GL_FILL);
     glColor3f(1.0, 1.0, 1.0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glVertexPointer(3, GL_FLOAT, sizeof(Vertex), &vertices[0].r);
-    glNormalPointer(GL_FLOAT, sizeof(Vertex), &vertices[0].n);
-
-    for (int i = 0; i < cols; i++)
-        glDrawElements(GL_TRIANGLE_STRIP, (rows + 1) * 2, GL_UNSIGNED_INT, &indices[i * (rows + 1) * 2]);
+    tiledGrid.draw();
 
     glPopAttrib();
 }
-void drawGrid2DVBOs(int rows, int cols) {
-    glPushAttrib(GL_CURRENT_BIT);
-    glPolygonMode(GL_FRONT_AND_BACK, fillMode == LINE ? GL_LINE : GL_FILL);
-    glColor3f(1.0, 1.0, 1.0);
 
-    bindVBOs();
-    glVertexPointer(3, GL_FLOAT, sizeof(Vertex), BUFFER_OFFSET(0));
-    glNormalPointer(GL_FLOAT, sizeof(Vertex), BUFFER_OFFSET(sizeof(vec3f)));
 
-    /* Grid */
-    for (int i = 0; i < cols; i++) {
-        glDrawElements(GL_TRIANGLE_STRIP, (rows + 1) * 2, GL_UNSIGNED_INT,
-                       BUFFER_OFFSET(i * (rows + 1) * 2 * sizeof(unsigned int)));
+///////////////////////////////////////////////////////////////////////////////
+// hand the whole frame in src to the uploader, packed on the way in the
+// compact format. parallel: the pool may pack, it is not the simulation
+// thread's right now.
+///////////////////////////////////////////////////////////////////////////////
+void uploadVertices(const Vertex *src, bool parallel)
+{
+    if (!COMPACT_VERTICES)
+    {
+        uploader.write(src, n_vertices * sizeof(Vertex));
+        return;
     }
-    unbindVBOs();
-    glPopAttrib();
+
+    auto pack = [src, parallel](PackedVertex *dst) {
+        if (parallel)
+            pool.run(n_vertices, VERTEX_BAND_ALIGN, [=](unsigned begin, unsigned end) {
+                packVertices(dst, src, begin, end);
+            });
+        else
+            packVertices(dst, src, 0, n_vertices);
+    };
+
+    auto *ptr = (PackedVertex *)uploader.map();
+    if (ptr)
+    {
+        pack(ptr);
+        uploader.unmap();
+        return;
+    }
+
+    // ORPHAN uploads from a packed copy
+    static std::vector<PackedVertex> packed;
+    packed.resize(n_vertices);
+    pack(packed.data());
+    uploader.write(packed.data(), n_vertices * sizeof(PackedVertex));
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// wobble the vertex in and out along normal
+// temporal decimation: update one of UPDATE_SLICES slices of columns per
+// frame, so each slice moves every UPDATE_SLICES-th frame. A grid column
+// is rows+1 consecutive vertices, so a slice is a single range of the VBO.
 ///////////////////////////////////////////////////////////////////////////////
-void updateVerticesIM(Vertex *vertices,unsigned count,float time)
+void updateSlice(float time)
 {
-    if (STATIC_RENDERING)
+    static unsigned next = 0;
+    unsigned columns = grid.cols + 1;
+    unsigned slices = std::min(UPDATE_SLICES, columns);
+    unsigned slice = next++ % slices;
+    unsigned begin = columns * slice / slices * (grid.rows + 1);
+    unsigned end = columns * (slice + 1) / slices * (grid.rows + 1);
+
+    // the recurrence steps every phasor once per frame; slices skip
+    // frames, so they are evaluated directly
+    beginWaveUpdateWith(waveEval == EVAL_RECURRENCE ? EVAL_DIRECT : waveEval, n_vertices, &grid, sws, nsw, time);
+    pool.run(end - begin, VERTEX_BAND_ALIGN, [=](unsigned b, unsigned e) {
+        if (SOA_LAYOUT)
+            updateWaveSoARange(&soa, vertices, vertices, begin + b, begin + e);
+        else
+            updateWaveRange(vertices, vertices, begin + b, begin + e);
+    });
+    dirtyRanges.add(begin, end);
+    updatedVertices = end - begin;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// upload the ranges in dirtyRanges and start over. Ranges a few columns
+// apart go up as one, a call per column would cost more than the gap.
+///////////////////////////////////////////////////////////////////////////////
+void uploadDirty()
+{
+    dirtyRanges.coalesce(4 * (grid.rows + 1));
+    if (!COMPACT_VERTICES)
     {
+        uploader.writeRanges(vertices, sizeof(Vertex), dirtyRanges);
+        dirtyRanges.clear();
         return;
     }
 
-    if(!vertices)
-        return;
+    // pack just the dirty ranges; the rest of the copy still holds what
+    // was packed when it last changed, which the persistent ring may need
+    static std::vector<PackedVertex> packed;
+    packed.resize(n_vertices);
+    PackedVertex *dst = packed.data();
+    const std::vector<DirtyRanges::Range> &ranges = dirtyRanges.getRanges();
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        unsigned first = ranges[i].begin;
+        pool.run(ranges[i].end - first, VERTEX_BAND_ALIGN, [=](unsigned begin, unsigned end) {
+            packVertices(dst, vertices, first + begin, first + end);
+        });
+    }
+    uploader.writeRanges(dst, sizeof(PackedVertex), dirtyRanges);
+    dirtyRanges.clear();
+}
 
-    float x, y, z;
-    float nx,ny,nz;
-    float dydx;
 
-    for(int i=0; i < count; ++i)
+///////////////////////////////////////////////////////////////////////////////
+// run the wave update on the thread pool. The once-per-frame part runs here,
+// then every thread writes its own band of dst, which may be the pointer
+// returned by glMapBuffer().
+///////////////////////////////////////////////////////////////////////////////
+void updateVerticesParallel(Vertex *dst, const Vertex *src, unsigned count, float time)
+{
+    if (OCEAN_MODE && count == (grid.rows + 1) * (grid.cols + 1))
     {
-        x = vertices[i].r.x;
-        y = vertices[i].r.y;
-        z = vertices[i].r.z;
-
-        calcSineWave3D(sws[0],x,z,time,&y,true,&dydx);
-        ny = dydx;
+        ocean.update(dst, &grid, time, pool);
+        return;
+    }
 
-        // update vertex coords
-        vertices[i].r.y = y;
-        vertices[i].n.x = -ny;
+    beginWaveUpdate(count, &grid, sws, nsw, time);
+    if (SOA_LAYOUT)
+    {
+        // evaluate on the mirror, scatter y/n.x into dst band by band while
+        // the band is still in cache
+        pool.run(count, VERTEX_BAND_ALIGN, [=](unsigned begin, unsigned end) {
+            updateWaveSoARange(&soa, dst, src, begin, end);
+        });
+        return;
     }
+    pool.run(count, VERTEX_BAND_ALIGN, [=](unsigned begin, unsigned end) {
+        updateWaveRange(dst, src, begin, end);
+    });
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// start the simulation thread on the current grid. Keys stop it before they
+// change anything it reads; display() restarts it on the next frame.
+///////////////////////////////////////////////////////////////////////////////
+void startSimulator(float time)
+{
+    const Vertex *src = vertices;
+    unsigned count = n_vertices;
+    simulator.start(vertices, n_vertices, [src, count](Vertex *dst, float t, std::vector<double> *threadTimes) {
+        updateVerticesParallel(dst, src, count, t);
+        threadTimes->resize(pool.getThreadCount());
+        for (unsigned i = 0; i < threadTimes->size(); ++i)
+            (*threadTimes)[i] = pool.getThreadTimeInMilliSec(i);
+    }, time);
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // wobble the vertex in and out along normal
 ///////////////////////////////////////////////////////////////////////////////
-void updateVertices(Vertex* dstVertices, Vertex* srcVertices, int count, float time)
+void updateVerticesIM(Vertex *vertices,unsigned count,float time)
 {
     if (STATIC_RENDERING)
     {
         return;
     }
 
-    if(!dstVertices || !srcVertices)
+    if(!vertices)
         return;
 
-    float x, y, z;
+    // update vertex coords in place
+    updateVerticesParallel(vertices, vertices, count, time);
+    updatedVertices = count;
+}
 
-    for(int i=0; i < count; ++i)
-    {
-        x = srcVertices[i].r.x;
-        y = srcVertices[i].r.y;
-        z = srcVertices[i].r.z;
 
-        float dxdy;
-        calcSineWave3D(sws[0],x,z,time,&y,true,&dxdy);
 
-        // update vertex coords
-        dstVertices[i].r.y = y;
-        dstVertices[i].n.x = -dxdy;
+///////////////////////////////////////////////////////////////////////////////
+// wobble the vertex in and out along normal
+///////////////////////////////////////////////////////////////////////////////
+void updateVertices(Vertex* dstVertices, Vertex* srcVertices, int count, float time)
+{
+    if (STATIC_RENDERING)
+    {
+        return;
     }
+
+    if(!dstVertices || !srcVertices)
+        return;
+
+    updateVerticesParallel(dstVertices, srcVertices, count, time);
+    updatedVertices = count;
 }
 
 void checkForGLerrors(int lineno) {
@@ -554,6 +1520,7 @@ void postRedisplay() {
 }
 
 void quit(int code) {
+    simulator.stop();
     SDL_DestroyWindow(window);
     SDL_Quit();
     exit(code);
@@ -639,12 +1606,66 @@ void initLights() {
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// --bench-upload: every strategy at a few grid sizes, BENCH_FRAMES frames of
+// update, upload and draw each. All strategies write whole frames here, so
+// the upload times compare the transfer alone.
+///////////////////////////////////////////////////////////////////////////////
+void benchUploads()
+{
+    const unsigned SIZES[] = {100, 300, 1000};
+    const int BENCH_FRAMES = 120;
+    UploadStrategy saved = uploader.getStrategy();
+    setRenderMode(VERTEX_BUFFER_OBJECT);
+
+    printf("%-20s %6s %10s %10s %8s %10s\n", "strategy", "grid", "upload ms", "frame ms", "stalls", "stall ms");
+    for (unsigned size : SIZES)
+    {
+        computeAndStoreGrid2D(size, size);
+        for (int s = 0; s < nUpload; ++s)
+        {
+            if (!uploader.isSupported((UploadStrategy) s))
+            {
+                printf("%-20s %6u %10s\n", uploadStrategyName((UploadStrategy) s), size, "unsupported");
+                continue;
+            }
+            uploader.setStrategy((UploadStrategy) s);
+            buildVBOs();
+
+            double upload = 0;
+            Timer frames;
+            frames.start();
+            for (int f = 0; f < BENCH_FRAMES; ++f)
+            {
+                updateVertices(vertices, vertices, n_vertices, f / 60.0f);
+                uploadVertices(vertices, true);
+                upload += uploader.getUploadTimeInMilliSec();
+
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                enableVBOs();
+                drawGrid2DVBOs(rows, cols, uploader.getDrawBuffer(), uploader.getDrawOffset());
+                uploader.drawn();
+                disableVBOs();
+                SDL_GL_SwapWindow(window);
+            }
+            frames.stop();
+            printf("%-20s %6u %10.3f %10.3f %8u %10.3f\n", uploadStrategyName((UploadStrategy) s), size,
+                   upload / BENCH_FRAMES, frames.getElapsedTimeInMilliSec() / BENCH_FRAMES, uploader.getStalls(),
+                   uploader.getStallTimeInMilliSec());
+        }
+    }
+    uploader.setStrategy(saved);
+}
+
+
 // OpenGL initialisation
 void init(void) {
     glShadeModel(GL_FLAT);
     glColor3f(1.0, 1.0, 1.0);
     computeAndStoreGrid2D(rows, cols);
-    buildVBOs();
+    // started in TILED_VBO (--tiled): the one-piece grid is built when it is left
+    if (renMode != TILED_VBO)
+        buildVBOs();
 }
 
 
@@ -688,6 +1709,7 @@ void DrawAxes(float len) {
 }
 
 void display(void) {
+    acceptGrid();
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -706,7 +1728,16 @@ void display(void) {
 
     glTranslatef(0, -1.57f, 0);
 
+    // the same camera for the core renderer, which has no matrix stack
+    modelViewMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, -cameraDistance));
+    modelViewMatrix = glm::rotate(modelViewMatrix, glm::radians(cameraAngleX), glm::vec3(1, 0, 0));
+    modelViewMatrix = glm::rotate(modelViewMatrix, glm::radians(cameraAngleY), glm::vec3(0, 1, 0));
+    modelViewMatrix = glm::translate(modelViewMatrix, glm::vec3(0, -1.57f, 0));
+    normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelViewMatrix)));
+
     t1.start();
+    bool asyncFrame = false;
+    updatedVertices = 0;
 
     DrawAxes(1);
 
@@ -747,37 +1778,157 @@ void display(void) {
         drawGrid2DVAs(rows,cols);
         disableVAs();
     }
-    else if (renMode == VERTEX_BUFFER_OBJECT)
+    else if ((renMode == VERTEX_BUFFER_OBJECT || renMode == VBO_SINGLE_DRAW) && splitStreams())
     {
-        enableVBOs();
+        // measure the elapsed time of updateVertices() and the stream upload
+        t2.start(); //---------------------------------------------------------
+        if (!STATIC_RENDERING)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, vboDynamic);
+            if (ASYNC_UPDATE)
+            {
+                if (!simulator.isRunning())
+                    startSimulator((float)timer.getElapsedTime());
+                const Vertex *frame = simulator.acquire();
+                simulator.request((float)timer.getElapsedTime());
+
+                static std::vector<HeightSlope> stream;
+                stream.resize(n_vertices);
+                gatherHeightSlope(stream.data(), frame, 0, n_vertices);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, n_vertices * sizeof(HeightSlope), stream.data());
+                asyncFrame = true;
+                updatedVertices = n_vertices;
+            }
+            else
+            {
+                // only the 8 bytes of (y, n.x) per vertex cross the bus
+                updateVertices(vertices, vertices, n_vertices, (float)timer.getElapsedTime());
+                auto *ptr = (HeightSlope *)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+                if (ptr)
+                {
+                    pool.run(n_vertices, VERTEX_BAND_ALIGN, [=](unsigned begin, unsigned end) {
+                        gatherHeightSlope(ptr, vertices, begin, end);
+                    });
+                    glUnmapBuffer(GL_ARRAY_BUFFER);
+                }
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        t2.stop(); //----------------------------------------------------------
+        updateTime = asyncFrame ? (float)simulator.getStepTimeInMilliSec() : (float)t2.getElapsedTimeInMilliSec();
 
-        // measure the elapsed time of updateVertices()
+        drawGrid2DStreams(rows, cols);
+    }
+    else if (renMode == VERTEX_BUFFER_OBJECT || renMode == VBO_SINGLE_DRAW || renMode == CORE_VAO)
+    {
+        // CORE_VAO keeps its layout in the vertex array, no client state;
+        // if it cannot be set up this frame is drawn as VERTEX_BUFFER_OBJECT
+        bool core = renMode == CORE_VAO && (coreRenderer.isCreated() || buildCore());
+        if (!core)
+        {
+            enableVBOs();
+            // the split path and buildVBOs() leave other buffers bound
+            bindVBOs();
+        }
+
+        // measure the elapsed time of updateVertices() and the upload
         t2.start(); //---------------------------------------------------------
-        if (!STATIC_RENDERING && !USE_SHADER)
+        if (ASYNC_UPDATE && !STATIC_RENDERING && !USE_SHADER)
+        {
+            // show the newest frame of the simulation thread and let it
+            // start on the next one while this one is uploaded and drawn
+            if (!simulator.isRunning())
+                startSimulator((float)timer.getElapsedTime());
+            const Vertex *frame = simulator.acquire();
+            simulator.request((float)timer.getElapsedTime());
+            // the pool belongs to the simulation thread now, pack here
+            uploadVertices(frame, false);
+            asyncFrame = true;
+            updatedVertices = n_vertices;
+        }
+        else if (!STATIC_RENDERING && !USE_SHADER && UPDATE_SLICES > 1 && !OCEAN_MODE)
+        {
+            // one slice of columns moves, only its vertices are uploaded
+            updateSlice((float)timer.getElapsedTime());
+            uploadDirty();
+        }
+        else if (!STATIC_RENDERING && !USE_SHADER)
         {
-            // map the buffer object into client's memory
             // Note that glMapBuffer() causes sync issue.
-            // If GPU is working with this buffer, glMapBufferARB() will wait(stall)
-            // for GPU to finish its job.
-            auto *ptr = (Vertex *)glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
-            if(ptr)
+            // If GPU is working with this buffer, glMapBuffer() will wait(stall)
+            // for GPU to finish its job; see Uploader.h for the other ways.
+            auto *ptr = uploader.keepsContents() && !COMPACT_VERTICES ? (Vertex *)uploader.map() : NULL;
+            if (ptr)
             {
-                // wobble vertex in and out along normal
+                // wobble vertex in and out along normal, straight into the buffer
                 updateVertices(ptr, vertices, n_vertices, (float)timer.getElapsedTime());
-                glUnmapBuffer(GL_ARRAY_BUFFER);     // release pointer to mapping buffer
+                uploader.unmap();
+            }
+            else
+            {
+                // update the float copy in place, then upload all of it
+                updateVertices(vertices, vertices, n_vertices, (float)timer.getElapsedTime());
+                uploadVertices(vertices, true);
+            }
+        }
+
+        t2.stop(); //----------------------------------------------------------
+        // the simulation thread's step overlaps the drawing, it is not part
+        // of this frame's time on the main thread
+        updateTime = asyncFrame ? (float)simulator.getStepTimeInMilliSec() : (float)t2.getElapsedTimeInMilliSec();
+        if (core)
+            drawGrid2DCore(rows, cols, uploader.getDrawBuffer(), uploader.getDrawOffset());
+        else if (USE_SHADER)
+            drawShaderPasses(rows, cols, uploader.getDrawBuffer(), uploader.getDrawOffset());
+        else
+            drawGrid2DVBOs(rows, cols, uploader.getDrawBuffer(), uploader.getDrawOffset());
+        uploader.drawn();
+        if (!core)
+            disableVBOs();
+    }
+    else if (renMode == HEIGHTMAP_TEXTURE)
+    {
+        // entered, resized, or the texel format toggled with the compact
+        // vertices; a failure leaves the mode and skips this frame
+        if (heightmap.matches(grid.rows, grid.cols, COMPACT_VERTICES) || buildHeightmap())
+        {
+            // measure the update and the copy of the heights into the pixel buffer
+            t2.start(); //-----------------------------------------------------
+            if (!STATIC_RENDERING)
+            {
+                uploadHeights((float)timer.getElapsedTime());
+                updatedVertices = n_vertices;
             }
+            t2.stop(); //------------------------------------------------------
+            updateTime = (float)t2.getElapsedTimeInMilliSec();
+            drawGrid2DHeightmap(rows, cols);
         }
+    }
+    else if (renMode == TILED_VBO)
+    {
+        // entered with another size, or resized by the background builder
+        if (!tiledGrid.matches(rows, cols))
+            buildTiles();
 
+        // measure the elapsed time of the update and upload of every tile
+        t2.start(); //---------------------------------------------------------
+        if (!STATIC_RENDERING && !USE_SHADER)
+        {
+            tiledGrid.update(sws, nsw, (float)timer.getElapsedTime(), pool);
+            updatedVertices = (uint64_t) tiledGrid.getTileCount() * TiledGrid::TILE_VERTICES;
+        }
         t2.stop(); //----------------------------------------------------------
         updateTime = (float)t2.getElapsedTimeInMilliSec();
-        drawGrid2DVBOs(rows, cols);
+
+        enableVBOs();
+        drawGrid2DTiles();
         disableVBOs();
     }
 
     glPopMatrix();
 
     t1.stop(); //===============================================================
-    drawTime = ((float) t1.getElapsedTimeInMilliSec() - updateTime);
+    drawTime = (float) t1.getElapsedTimeInMilliSec() - (asyncFrame ? 0.0f : updateTime);
 
     if (drawTime > max)
     {
@@ -832,7 +1983,17 @@ void deleteVBO()
 {
     glDeleteBuffers(1, &ibo);
     glDeleteBuffers(1, &vbo);
-    ibo = vbo = 0;
+    glDeleteBuffers(1, &vboStatic);
+    glDeleteBuffers(1, &vboDynamic);
+    ibo = vbo = vboStatic = vboDynamic = 0;
+    glDeleteBuffers(1, &iboSingle);
+    glDeleteBuffers(1, &vboFeedback);
+    iboSingle = vboFeedback = 0;
+    iboBytes = vboBytes = vboStaticBytes = vboDynamicBytes = iboSingleBytes = vboFeedbackBytes = 0;
+    shaderTimer.release();
+    feedbackTimer.release();
+    uploader.release();
+    accountMemory();
 }
 
 
@@ -848,6 +2009,7 @@ void toPerspective() {
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
     gluPerspective(45.0f, (float) (screenWidth) / screenHeight, 1.0f, 1000.0f); // FOV, AspectRatio, NearClip, FarClip
+    projectionMatrix = glm::perspective(glm::radians(45.0f), (float) (screenWidth) / screenHeight, 1.0f, 1000.0f);
 
     // switch to modelview matrix in order to set scene
     glMatrixMode(GL_MODELVIEW);
@@ -864,6 +2026,9 @@ void reshape(int w, int h) {
 void keyDown(SDL_KeyboardEvent *e) {
     max = -999;
 
+    // most keys change state the simulation thread reads
+    simulator.stop();
+
 
     switch (e->keysym.sym) {
         case SDLK_ESCAPE:
@@ -875,6 +2040,7 @@ void keyDown(SDL_KeyboardEvent *e) {
 
         case SDLK_p:
             PAUSE = !PAUSE;
+            resetWaveRecurrence();
             break;
 
         case SDLK_w:
@@ -882,6 +2048,7 @@ void keyDown(SDL_KeyboardEvent *e) {
 
         case SDLK_s:
             STATIC_RENDERING = !STATIC_RENDERING;
+            resetWaveRecurrence();
             break;
 
         case SDLK_a:
@@ -896,34 +2063,130 @@ void keyDown(SDL_KeyboardEvent *e) {
             }
             break;
 
+        case SDLK_c:
+            TRANSFORM_FEEDBACK = !TRANSFORM_FEEDBACK;
+            break;
+
+        case SDLK_j:
+            // 1, 2 or 4 draws of the shader path
+            SHADER_PASSES = SHADER_PASSES < 4 ? SHADER_PASSES * 2 : 1;
+            break;
+
         case SDLK_d:
+            // 1, 2, 4, ... 16 slices, then back to updating the whole grid;
+            // every slice starts from the same freshly uploaded frame
+            UPDATE_SLICES = UPDATE_SLICES < 16 ? UPDATE_SLICES * 2 : 1;
+            buildVBOs();
             break;
 
-        case SDLK_UP:
-            rows+=10;
-            computeAndStoreGrid2D(rows,cols);
-            deleteVBO();
+        case SDLK_k:
+            // cycle through the kernels this CPU supports
+            do {
+                waveKernel = (WaveKernel)((int)waveKernel+1 < nKernel ? (int)waveKernel+1 : 0);
+            } while (!waveKernelSupported(waveKernel));
+            break;
+
+        case SDLK_t:
+        {
+            // 1, 2, 4, ... up to one thread per core, then back to 1
+            unsigned cores = std::thread::hardware_concurrency();
+            unsigned next = pool.getThreadCount() * 2;
+            if (pool.getThreadCount() >= cores)
+                next = 1;
+            else if (next > cores)
+                next = cores;
+            pool.setThreadCount(next);
+            break;
+        }
+
+        case SDLK_EQUALS:
+            addWave();
+            break;
+
+        case SDLK_MINUS:
+            removeWave();
+            break;
+
+        case SDLK_e:
+            waveEval = (WaveEval)((int)waveEval+1 < nEval ? (int)waveEval+1 : 0);
+            break;
+
+        case SDLK_g:
+            // sine only writes y and n.x, so rebuild the flat grid to drop
+            // the horizontal displacement and full normals of Gerstner
+            waveModel = (WaveModel)((int)waveModel+1 < nModel ? (int)waveModel+1 : 0);
+            computeAndStoreGrid2D(nextRows,nextCols);
             buildVBOs();
             break;
-        case SDLK_DOWN:
-            rows-=10;
-            computeAndStoreGrid2D(rows,cols);
-            deleteVBO();
+
+        case SDLK_x:
+            SPLIT_STREAMS = !SPLIT_STREAMS;
+            break;
+
+        case SDLK_v:
+            COMPACT_VERTICES = !COMPACT_VERTICES;
+            computeAndStoreGrid2D(nextRows,nextCols);
             buildVBOs();
             break;
-        case SDLK_LEFT:
-            cols-=10;
-            computeAndStoreGrid2D(rows,cols);
-            deleteVBO();
+
+        case SDLK_u:
+            ASYNC_UPDATE = !ASYNC_UPDATE;
+            break;
+
+        case SDLK_m:
+            SOA_LAYOUT = !SOA_LAYOUT;
+            break;
+
+        case SDLK_b:
+            dumpMemory(stdout);
+            break;
+
+        case SDLK_r:
+            // a new strategy starts from freshly uploaded vertices
+            uploader.setStrategy((UploadStrategy)((int)uploader.getStrategy()+1 < nUpload
+                                                  ? (int)uploader.getStrategy()+1 : 0));
             buildVBOs();
             break;
-        case SDLK_RIGHT:
-            cols+=10;
-            computeAndStoreGrid2D(rows,cols);
-            deleteVBO();
+
+        case SDLK_n:
+            // the grid build uses the tier too, so rebuild it like the arrows do
+            trigTier = (TrigTier)((int)trigTier+1 < nTrig ? (int)trigTier+1 : 0);
+            computeAndStoreGrid2D(nextRows,nextCols);
+            buildVBOs();
+            break;
+
+        case SDLK_o:
+            // the tiles are evaluated tile by tile, the FFT needs all of the grid
+            if (renMode == TILED_VBO)
+            {
+                fprintf(stderr, "no FFT ocean in TILED_VBO\n");
+                break;
+            }
+            // the ocean writes full normals, rebuild the grid when leaving it
+            OCEAN_MODE = !OCEAN_MODE;
+            computeAndStoreGrid2D(nextRows,nextCols);
             buildVBOs();
             break;
 
+        case SDLK_UP:
+            nextRows += 10;
+            requestGrid();
+            break;
+        case SDLK_DOWN:
+            if (nextRows > 10)
+                nextRows -= 10;
+            requestGrid();
+            break;
+        case SDLK_LEFT:
+            if (nextCols > 10)
+                nextCols -= 10;
+            requestGrid();
+            break;
+        case SDLK_RIGHT:
+            nextCols += 10;
+            requestGrid();
+            break;
+
 
         case SDLK_l:
             lightMode = !lightMode;
@@ -941,34 +2204,62 @@ void keyDown(SDL_KeyboardEvent *e) {
 
         case SDLK_SPACE:
         {
-            renMode = (RenderMode)((int)renMode+1 < 5 ? (int)renMode+1 : 0);
+            RenderMode mode = (RenderMode)((int)renMode+1 < 9 ? (int)renMode+1 : 0);
+            if (mode == TILED_VBO && OCEAN_MODE)
+                mode = HEIGHTMAP_TEXTURE;
+            setRenderMode(mode);
             break;
         }
 
         case SDLK_1:
-            renMode = IMMEDIATE_MODE;
+            setRenderMode(IMMEDIATE_MODE);
             break;
 
         case SDLK_2:
-            renMode = STORE_ARRAY;
+            setRenderMode(STORE_ARRAY);
             break;
 
         case SDLK_3:
-            renMode = STORE_ARRAY_INDICE;
+            setRenderMode(STORE_ARRAY_INDICE);
             break;
 
         case SDLK_4:
-            renMode = VERTEXT_ARRAY;
+            setRenderMode(VERTEXT_ARRAY);
             break;
 
         case SDLK_5:
-            renMode = VERTEX_BUFFER_OBJECT;
+            setRenderMode(VERTEX_BUFFER_OBJECT);
+            break;
+
+        case SDLK_6:
+            setRenderMode(VBO_SINGLE_DRAW);
+            break;
+
+        case SDLK_7:
+            setRenderMode(TILED_VBO);
+            break;
+
+        case SDLK_8:
+            setRenderMode(HEIGHTMAP_TEXTURE);
+            break;
+
+        case SDLK_9:
+            setRenderMode(CORE_VAO);
+            break;
+
+        case SDLK_i:
+            indexOrder = (IndexOrder)((int)indexOrder+1 < nOrder ? (int)indexOrder+1 : 0);
+            singleIndicesStale = true;
             break;
 
         case SDLK_f:
             fillMode = (FillingMode)((int)fillMode+1 < 2 ? (int)fillMode+1 : 0);
             break;
 
+        case SDLK_h:
+            HUD_DETAILS = !HUD_DETAILS;
+            break;
+
         default:
             break;
     }
@@ -1088,6 +2379,17 @@ void eventDispatcher() {
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// size of the linked program's binary, 0 where GL can't tell (before 4.1)
+///////////////////////////////////////////////////////////////////////////////
+size_t programBytes(GLuint program)
+{
+    GLint length = 0;
+    if (program && (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary))
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    return (size_t) length;
+}
+
 GLint getUniLoc(GLuint program, const GLchar *name)
 {
     GLint loc;
@@ -1100,9 +2402,26 @@ GLint getUniLoc(GLuint program, const GLchar *name)
     return loc;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// the wave uniforms of basicVer.vert and feedback.vert; program must be the
+// one in use
+///////////////////////////////////////////////////////////////////////////////
+void setWaveUniforms(GLuint program) {
+    glUniform1f(getUniLoc(program, "Time"), timer.getElapsedTime());
+    // the tiles always hold full vertices
+    glUniform1f(getUniLoc(program, "PositionScale"),
+                COMPACT_VERTICES && renMode != TILED_VBO ? PACKED_POSITION_SCALE : 1.0f);
+
+    // same waves as the CPU path, packed as (A, k, w)
+    int count = nsw < MAX_SHADER_WAVES ? nsw : MAX_SHADER_WAVES;
+    glUniform1i(getUniLoc(program, "WaveCount"), count);
+    if (count > 0)
+        glUniform3fv(getUniLoc(program, "Waves"), count, &sws[0].A);
+}
+
 // Used to update application state e.g. compute physics, game AI
 void update() {
-    glUniform1f(getUniLoc(program, "Time"), timer.getElapsedTime());
+    setWaveUniforms(program);
 }
 
 [[noreturn]] /*
@@ -1163,6 +2482,8 @@ int initGraphics() {
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
     glewInit();
+    packedNormal1010102 = GLEW_VERSION_3_3 || GLEW_ARB_vertex_type_2_10_10_10_rev;
+    stitchMode = GLEW_VERSION_3_1 ? STITCH_RESTART : STITCH_DEGENERATE;
 
     int w, h;
     SDL_GetWindowSize(window, &w, &h);
@@ -1217,6 +2538,115 @@ void initGL()
 int main(int argc, char **argv) {
     glutInit(&argc, argv);
 
+    int benchSize = 0;
+    bool benchUpload = false;
+    int reportSize = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            threadCount = (unsigned) atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--ocean"))
+            OCEAN_MODE = true;
+        else if (!strcmp(argv[i], "--async"))
+            ASYNC_UPDATE = true;
+        else if (!strcmp(argv[i], "--compact"))
+            COMPACT_VERTICES = true;
+        else if (!strcmp(argv[i], "--split"))
+            SPLIT_STREAMS = true;
+        else if (!strcmp(argv[i], "--ring"))
+            uploader.setStrategy(UPLOAD_PERSISTENT);
+        else if (!strcmp(argv[i], "--upload") && i + 1 < argc)
+        {
+            UploadStrategy strategy;
+            if (parseUploadStrategy(argv[++i], &strategy))
+                uploader.setStrategy(strategy);
+            else
+                fprintf(stderr, "unknown upload strategy %s, use map_read_write, map_invalidate, "
+                                "map_unsynchronized, orphan or persistent\n", argv[i]);
+        }
+        else if (!strcmp(argv[i], "--bench-upload"))
+            benchUpload = true;
+        else if (!strcmp(argv[i], "--slices") && i + 1 < argc)
+            UPDATE_SLICES = (unsigned) atoi(argv[++i]) > 1 ? (unsigned) atoi(argv[i]) : 1;
+        else if (!strcmp(argv[i], "--soa"))
+            SOA_LAYOUT = true;
+        else if (!strcmp(argv[i], "--tiled"))
+            renMode = TILED_VBO;
+        else if (!strcmp(argv[i], "--heightmap"))
+            renMode = HEIGHTMAP_TEXTURE;
+        else if (!strcmp(argv[i], "--core"))
+            renMode = CORE_VAO;
+        else if (!strcmp(argv[i], "--feedback"))
+            TRANSFORM_FEEDBACK = true;
+        else if (!strcmp(argv[i], "--passes") && i + 1 < argc)
+        {
+            SHADER_PASSES = (unsigned) atoi(argv[++i]);
+            if (SHADER_PASSES < 1)
+                SHADER_PASSES = 1;
+            if (SHADER_PASSES > PassTimer::MAX_PASSES - 1)
+                SHADER_PASSES = PassTimer::MAX_PASSES - 1;
+        }
+        else if (!strcmp(argv[i], "--grid") && i + 2 < argc)
+        {
+            rows = nextRows = (unsigned) atoi(argv[++i]) > 10 ? (unsigned) atoi(argv[i]) : 10;
+            cols = nextCols = (unsigned) atoi(argv[++i]) > 10 ? (unsigned) atoi(argv[i]) : 10;
+        }
+        else if (!strcmp(argv[i], "--no-huge-pages"))
+            gridHugePages = false;
+        else if (!strcmp(argv[i], "--mem-budget") && i + 1 < argc)
+            memBudget = (size_t) (atof(argv[++i]) * 1024 * 1024);
+        else if (!strcmp(argv[i], "--trig") && i + 1 < argc)
+        {
+            if (!parseTrigTier(argv[++i], &trigTier))
+                fprintf(stderr, "unknown trig tier %s, use libm, poly9, poly5 or lut\n", argv[i]);
+        }
+        else if (!strcmp(argv[i], "--cache") && i + 1 < argc)
+            vertexCacheSize = (unsigned) atoi(argv[++i]) > 4 ? (unsigned) atoi(argv[i]) : 4;
+        else if (!strcmp(argv[i], "--index-report") && i + 1 < argc)
+            reportSize = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--bench-layout") && i + 1 < argc)
+            benchSize = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--trig-sweep"))
+        {
+            sweepTrig(-1000.0f, 1000.0f, 1 << 22);
+            return 0;
+        }
+        else if (!strcmp(argv[i], "--waves") && i + 1 < argc)
+        {
+            int waves = atoi(argv[++i]);
+            if (waves < 0)
+                waves = 0;
+            while (nsw < waves && nsw < MAX_WAVES)
+                addWave();
+            if (waves < nsw)
+                nsw = waves;
+        }
+    }
+
+    if (OCEAN_MODE && renMode == TILED_VBO)
+    {
+        fprintf(stderr, "--tiled does not work with --ocean, drawing VERTEX_BUFFER_OBJECT\n");
+        renMode = VERTEX_BUFFER_OBJECT;
+    }
+
+    if (reportSize > 0)
+    {
+        reportIndexOrders((unsigned) reportSize, (unsigned) reportSize, vertexCacheSize);
+        return 0;
+    }
+
+    if (benchSize > 0)
+    {
+        // after the loop so --waves applies; a flat N x N grid is enough
+        // since only x/z feed the kernels
+        std::vector<Vertex> flat((benchSize + 1) * (benchSize + 1));
+        for (int i = 0, v = 0; i <= benchSize; i++)
+            for (int j = 0; j <= benchSize; j++, v++)
+                flat[v] = {{-1.0f + 2.0f * i / benchSize, 0, -1.0f + 2.0f * j / benchSize}, {0, 1, 0}, {1, 1, 1}};
+        benchWaveLayout(flat.data(), (unsigned) flat.size(), sws, nsw);
+        return 0;
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         fprintf(stderr, "%s:%d: unable to init SDL: %s\n",
                 __FILE__, __LINE__, SDL_GetError());
@@ -1232,6 +2662,8 @@ int main(int argc, char **argv) {
     // OpenGL initialisation, must be done before any OpenGL calls
     init();
     initSharedMem();
+    waveKernel = detectWaveKernel();
+    pool.setThreadCount(threadCount);
 //    initGL();
     atexit(sys_shutdown);
 
@@ -1241,8 +2673,42 @@ int main(int argc, char **argv) {
     // Put a call to getShader and glUseProgram here
     program = getShader("basicVer.vert","basicFrag.frag");
 
+    // generic attribute 0 must be in use, so pin the static stream to it
+    streamProgram = getShader("stream.vert","basicFrag.frag");
+    if (streamProgram)
+    {
+        glBindAttribLocation(streamProgram, 0, "StaticXZ");
+        glLinkProgram(streamProgram);
+    }
+    heightmapProgram = getShader("heightmap.vert","basicFrag.frag");
+    if (heightmapProgram)
+    {
+        glBindAttribLocation(heightmapProgram, 0, "StaticXZ");
+        glLinkProgram(heightmapProgram);
+    }
+    // the capture writes position and normal interleaved, vertex after vertex
+    feedbackProgram = getShader("feedback.vert","basicFrag.frag");
+    if (feedbackProgram && GLEW_VERSION_3_0)
+    {
+        const char *varyings[] = {"FeedbackPosition", "FeedbackNormal"};
+        glTransformFeedbackVaryings(feedbackProgram, 2, varyings, GL_INTERLEAVED_ATTRIBS);
+        glLinkProgram(feedbackProgram);
+    }
+    litProgram = getShader("lit.vert","basicFrag.frag");
+    // GLSL 3.30 would only fail to compile on older contexts
+    if (CoreRenderer::isSupported())
+        coreProgram = getShader("core.vert","core.frag");
+    memSet(MEM_PROGRAMS, programBytes(program) + programBytes(streamProgram) + programBytes(heightmapProgram)
+                         + programBytes(feedbackProgram) + programBytes(litProgram) + programBytes(coreProgram));
+
 //    glUseProgram(0);
 
+    if (benchUpload)
+    {
+        benchUploads();
+        return EXIT_SUCCESS;
+    }
+
     mainLoop();
 
     return EXIT_SUCCESS;
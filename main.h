@@ -16,8 +16,27 @@
 #include <sstream>
 #include <iomanip>
 #include <cstdlib>
+#include <cstring>
+#include <cstddef>
 #include "Timer.h"
+#include "ThreadPool.h"
 #include "shaders.h"
+#include "wave.h"
+#include "waveKernel.h"
+#include "Ocean.h"
+#include "fastTrig.h"
+#include "Simulator.h"
+#include "packedVertex.h"
+#include "gridAlloc.h"
+#include "GridBuilder.h"
+#include "gridIndex.h"
+#include "TiledGrid.h"
+#include "memBudget.h"
+#include "Uploader.h"
+#include "DirtyRanges.h"
+#include "HeightmapTexture.h"
+#include "PassTimer.h"
+#include "CoreRenderer.h"
 
 
 #define GLM_FORCE_RADIANS
@@ -27,32 +46,17 @@
 #include <glm/gtc/constants.hpp>
 
 
-typedef struct {
-    float x, y;
-} vec2f;
-
-typedef struct {
-    float x, y, z;
-} vec3f;
-
-typedef struct {
-    glm::vec3 r, n, c;
-} Vertex;
-
-
 // Globals
 bool debug = true;
 SDL_Window *window;
 const float gripper_increment = .2;
 const int milli = 1000;
 
-typedef struct {
-    float A;
-    float k;
-    float w;
-} sinewave;
-
-sinewave sws[] =
+// Waves summed over the grid, nsw of them are active. Keys +/- add and
+// remove waves at runtime. Only the first MAX_SHADER_WAVES reach the shader.
+const int MAX_WAVES = 256;
+const int MAX_SHADER_WAVES = 64;
+sinewave sws[MAX_WAVES] =
         {
                 {0.25, 2 * M_PI / 1, 0.25 * M_PI},
                 {0.25, 1 * M_PI / 1, 0.5 * M_PI}
@@ -65,7 +69,11 @@ enum RenderMode {
     STORE_ARRAY = 1,
     STORE_ARRAY_INDICE = 2,
     VERTEXT_ARRAY = 3,
-    VERTEX_BUFFER_OBJECT
+    VERTEX_BUFFER_OBJECT = 4,
+    VBO_SINGLE_DRAW = 5,                // the VBOs drawn with one stitched index buffer
+    TILED_VBO = 6,                      // the grid cut into tiles with a buffer each, see TiledGrid
+    HEIGHTMAP_TEXTURE = 7,              // a static grid displaced by a height texture, see HeightmapTexture
+    CORE_VAO = 8                        // the VBO drawn through a vertex array object, see CoreRenderer
 } renMode = VERTEX_BUFFER_OBJECT;
 
 enum FillingMode{
@@ -85,7 +93,11 @@ std::string MODE_STRING[] = {
         "STORE_ARRAY",
         "STORE_ARRAY_INDICE",
         "VERTEXT_ARRAY",
-        "VERTEX_BUFFER_OBJECT"
+        "VERTEX_BUFFER_OBJECT",
+        "VBO_SINGLE_DRAW",
+        "TILED_VBO",
+        "HEIGHTMAP_TEXTURE",
+        "CORE_VAO"
 };
 
 enum {
@@ -101,9 +113,45 @@ bool USE_SHADER = true;
 Vertex *vertices;
 unsigned *indices;
 unsigned n_vertices, n_indices;
+unsigned vertexCapacity, indexCapacity;     // allocated size of vertices/indices, only grows
 unsigned vbo, ibo;
-unsigned rows = 50, cols = 50;
+unsigned vboStatic, vboDynamic;     // split streams: x/z once, (y, n.x) every frame
+size_t vboBytes, iboBytes;          // storage of the buffer objects, only grows
+size_t vboStaticBytes, vboDynamicBytes;
+unsigned vboFeedback;               // position and normal per vertex, captured by feedbackProgram
+size_t vboFeedbackBytes;
+const size_t FEEDBACK_STRIDE = 6 * sizeof(float);
+unsigned iboSingle;                 // VBO_SINGLE_DRAW: all strips stitched into one index list
+size_t iboSingleBytes;
+unsigned singleIndexCount;
+GLenum singleIndexType;             // GL_UNSIGNED_SHORT when the grid allows it
+StitchMode stitchMode = STITCH_DEGENERATE;  // STITCH_RESTART once GL 3.1 is found
+GLenum singlePrimitive = GL_TRIANGLE_STRIP;
+IndexOrder indexOrder = ORDER_STRIPS;       // triangle order of the single-draw index buffer
+unsigned vertexCacheSize = 24;              // post-transform cache the orders are tuned for (--cache N)
+SingleIndices singleIndices;                // iboSingle's list and stats, ordered by gridBuilder when it can
+bool singleIndicesStale = true;             // iboSingle is of an older grid or order, rebuilt when drawn
+unsigned rows = 50, cols = 50;      // size of the grid being drawn
+unsigned nextRows = 50, nextCols = 50;  // size asked for by the arrow keys, built in the background
+GridBuilder gridBuilder;
+TiledGrid tiledGrid;                // the grid of TILED_VBO, the one-piece arrays catch up when it is left
+HeightmapTexture heightmap;         // the heights of HEIGHTMAP_TEXTURE, R16F with COMPACT_VERTICES
+WaveGrid grid;                      // layout of the grid in vertices, for the separable update
+ThreadPool pool;                    // workers for the vertex update
+unsigned threadCount = 0;           // threads used by pool, 0: one per core (--threads N)
+Ocean ocean;                        // FFT ocean, replaces the sine waves when OCEAN_MODE is on
+bool OCEAN_MODE = false;
+bool SPLIT_STREAMS = false;         // VBO path streams only height and slope (sine model only)
+Uploader uploader;                  // how the VBO path moves a frame into the buffer (key r, --upload)
+unsigned UPDATE_SLICES = 1;         // the VBO path updates one of this many column slices per frame (key d)
+DirtyRanges dirtyRanges;            // vertices the VBO path changed this frame, uploaded by uploadDirty()
+bool COMPACT_VERTICES = false;      // VBO holds PackedVertex (12 bytes) instead of Vertex (36 bytes)
+Simulator simulator;                // computes the next frame while this one is drawn (ASYNC_UPDATE)
+bool ASYNC_UPDATE = false;
+WaveSoA soa;                        // x/z/y/nx mirror of vertices for the SoA update (SOA_LAYOUT)
+bool SOA_LAYOUT = false;
 bool lightMode = true;
+bool HUD_DETAILS = false;           // second HUD page: memory, index order, GPU passes, uploads (key h)
 
 void idleCB();
 
@@ -120,6 +168,8 @@ void initLights();
 
 void deleteVBO(const GLuint vboId);
 void drawString(const char *str, int x, int y, float color[4], void *font);
+bool splitStreams();
+bool feedbackSupported();
 void drawString3D(const char *str, float pos[3], float color[4], void *font);
 void showInfo();
 void updateVertices(float *vertices, float *srcVertices, float *srcNormals, int count, float time);
@@ -151,6 +201,7 @@ bool vboSupported, vboUsed;
 int drawMode = 0;
 Timer timer, t1, t2;
 float drawTime, updateTime;
+uint64_t updatedVertices;           // vertices the CPU evaluated the waves for this frame, for ns/wave/vertex
 float *srcVertices;                 // pointer to copy of vertex array
 int vertexCount;                 // number of vertices
 
@@ -158,6 +209,16 @@ float min = 999;
 float max = -999;
 float average;
 GLuint program;
+GLuint streamProgram;               // pass-through shader for the split streams
+GLuint heightmapProgram;            // displaces the static x/z stream by the height texture
+GLuint feedbackProgram;             // evaluates the waves once per frame into vboFeedback
+GLuint litProgram;                  // draws vboFeedback, no waves
+bool TRANSFORM_FEEDBACK = false;    // shader path: capture the waves once, then draw the capture (key c)
+unsigned SHADER_PASSES = 1;         // draws of the grid per frame in the shader path (key j)
+PassTimer shaderTimer;              // GPU ms per pass, waves in every pass
+PassTimer feedbackTimer;            // GPU ms per pass, the capture first
+GLuint coreProgram;                 // core.vert + core.frag, GLSL 3.30 core
+CoreRenderer coreRenderer;          // the vertex array and uniforms of CORE_VAO
 
 /// GLM SET UP
 
@@ -169,6 +230,7 @@ glm::vec3 grey(0.8, 0.8, 0.8);
 glm::vec3 black(0.0, 0.0, 0.0);
 const float shininess = 50.0;
 
-glm::mat4 modelViewMatrix;
+glm::mat4 modelViewMatrix;          // the camera of display(), built with glm for CORE_VAO
 glm::mat3 normalMatrix;
+glm::mat4 projectionMatrix;         // set with the GL projection in toPerspective()
 #endif //TOWERDEFENSESDL_MAIN_H
@@ -0,0 +1,82 @@
+#include "memBudget.h"
+#include "gridAlloc.h"
+
+size_t memBudget = 0;
+
+static size_t bytesOf[nMem];
+
+static const char *const NAMES[nMem] = {
+        "grid", "builder", "soa", "vbo", "ibo", "streams", "ring", "tile buffers", "heightmap", "feedback", "programs"
+};
+
+
+const char *memCategoryName(MemCategory category)
+{
+    return category < nMem ? NAMES[category] : "?";
+}
+
+bool memIsGPU(MemCategory category)
+{
+    return category != MEM_GRID && category != MEM_BUILDER && category != MEM_SOA;
+}
+
+void memSet(MemCategory category, size_t bytes)
+{
+    if (category < nMem)
+        bytesOf[category] = bytes;
+}
+
+size_t memBytes(MemCategory category)
+{
+    return category < nMem ? bytesOf[category] : 0;
+}
+
+static size_t sideBytes(bool gpu)
+{
+    size_t total = 0;
+    for (int i = 0; i < nMem; ++i)
+        if (memIsGPU((MemCategory) i) == gpu)
+            total += bytesOf[i];
+    return total;
+}
+
+size_t memCPUBytes()
+{
+    return sideBytes(false);
+}
+
+size_t memGPUBytes()
+{
+    return sideBytes(true);
+}
+
+bool memFits(MemCategory first, MemCategory last, size_t bytes)
+{
+    if (!memBudget)
+        return true;
+
+    size_t others = 0;
+    for (int i = 0; i < nMem; ++i)
+        if (i < first || i > last)
+            others += bytesOf[i];
+    return others + bytes <= memBudget;
+}
+
+void dumpMemory(FILE *out)
+{
+    const double MB = 1024.0 * 1024.0;
+    fprintf(out, "%-14s %4s %10s\n", "category", "side", "MB");
+    for (int i = 0; i < nMem; ++i)
+        fprintf(out, "%-14s %4s %10.2f\n", NAMES[i], memIsGPU((MemCategory) i) ? "GPU" : "CPU", bytesOf[i] / MB);
+    fprintf(out, "%-14s %4s %10.2f\n", "total", "CPU", memCPUBytes() / MB);
+    fprintf(out, "%-14s %4s %10.2f\n", "total", "GPU", memGPUBytes() / MB);
+    if (memBudget)
+        fprintf(out, "budget %.2f MB, %.2f MB left\n", memBudget / MB,
+                ((double) memBudget - (double) (memCPUBytes() + memGPUBytes())) / MB);
+    else
+        fprintf(out, "no budget (--mem-budget MB)\n");
+
+    // everything from gridAlloc(), incl. scratch tables nobody reports
+    fprintf(out, "gridAlloc reserved %.2f MB in %u blocks, %.2f MB on huge pages\n",
+            gridReservedBytes() / MB, gridBlockCount(), gridHugeBytes() / MB);
+}
@@ -0,0 +1,50 @@
+#ifndef TOWERDEFENSESDL_MEMBUDGET_H
+#define TOWERDEFENSESDL_MEMBUDGET_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Bytes held per subsystem, CPU and GPU side. The owners report the size
+ * of what they hold after every (re)allocation with memSet(), capacities
+ * rather than what is in use, since that is what the grow-only arrays and
+ * buffers keep. GPU figures are the storage asked of the driver; programs
+ * count their binary size where GL can tell it.
+ *
+ * With a budget set (--mem-budget MB) a new grid size is checked against
+ * it before anything is allocated, see memFits().
+ */
+
+enum MemCategory {
+    MEM_GRID = 0,                   // CPU vertex and index arrays of the one-piece grid
+    MEM_BUILDER,                    // CPU spare and not yet taken arrays of the background builder
+    MEM_SOA,                        // CPU x/z/y/nx mirror of the grid
+    MEM_VBO,                        // GPU vertex buffer of the grid
+    MEM_IBO,                        // GPU column strip and single draw index buffers
+    MEM_STREAMS,                    // GPU split static and dynamic streams
+    MEM_RING,                       // GPU persistent stream ring, all segments
+    MEM_TILE_BUFFERS,               // GPU vertex buffers of the tiles and their shared indices
+    MEM_HEIGHTMAP,                  // GPU height texture and its pixel buffers
+    MEM_FEEDBACK,                   // GPU transform feedback capture of the waves
+    MEM_PROGRAMS,                   // GPU shader program binaries
+    nMem
+};
+
+extern size_t memBudget;            // bytes over all categories, 0: no budget
+
+const char *memCategoryName(MemCategory category);
+bool   memIsGPU(MemCategory category);
+
+void   memSet(MemCategory category, size_t bytes);
+size_t memBytes(MemCategory category);
+size_t memCPUBytes();
+size_t memGPUBytes();
+
+// would the total stay within the budget if the categories in [first,
+// last] held bytes instead of what they hold now; always true without one
+bool   memFits(MemCategory first, MemCategory last, size_t bytes);
+
+// every category, the totals, the budget and what gridAlloc() reserved
+void   dumpMemory(FILE *out);
+
+#endif //TOWERDEFENSESDL_MEMBUDGET_H
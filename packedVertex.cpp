@@ -0,0 +1,120 @@
+#include "packedVertex.h"
+#include <math.h>
+#include <string.h>
+
+bool packedNormal1010102 = false;
+
+
+static inline short packPosition(float v)
+{
+    float q = v * (1.0f / PACKED_POSITION_SCALE);
+    if (q > 32767.0f)
+        q = 32767.0f;
+    if (q < -32767.0f)
+        q = -32767.0f;
+    return (short) lrintf(q);
+}
+
+// signed normalized component of bits width, two's complement in the low bits
+static inline unsigned packSnorm(float v, int bits)
+{
+    int max = (1 << (bits - 1)) - 1;
+    if (v > 1.0f)
+        v = 1.0f;
+    if (v < -1.0f)
+        v = -1.0f;
+    return (unsigned) lrintf(v * max) & ((1u << bits) - 1);
+}
+
+static inline unsigned packNormal(const glm::vec3 &n)
+{
+    // the normals of the update are not unit length (n.y = 1)
+    float len = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+    float s = len > 0 ? 1.0f / len : 0.0f;
+
+    if (packedNormal1010102)
+        return packSnorm(n.x * s, 10) | packSnorm(n.y * s, 10) << 10 | packSnorm(n.z * s, 10) << 20;
+    return packSnorm(n.x * s, 8) | packSnorm(n.y * s, 8) << 8 | packSnorm(n.z * s, 8) << 16;
+}
+
+
+void packVertices(PackedVertex *dst, const Vertex *src, unsigned begin, unsigned end)
+{
+    for (unsigned i = begin; i < end; ++i)
+    {
+        dst[i].x = packPosition(src[i].r.x);
+        dst[i].y = packPosition(src[i].r.y);
+        dst[i].z = packPosition(src[i].r.z);
+        dst[i].pad = 0;
+        dst[i].n = packNormal(src[i].n);
+    }
+}
+
+
+void gatherStaticXZ(StaticXZ *dst, const Vertex *src, unsigned begin, unsigned end)
+{
+    for (unsigned i = begin; i < end; ++i)
+    {
+        dst[i].x = src[i].r.x;
+        dst[i].z = src[i].r.z;
+    }
+}
+
+void gatherHeightSlope(HeightSlope *dst, const Vertex *src, unsigned begin, unsigned end)
+{
+    for (unsigned i = begin; i < end; ++i)
+    {
+        dst[i].y = src[i].r.y;
+        dst[i].nx = src[i].n.x;
+    }
+}
+
+
+unsigned short floatToHalf(float v)
+{
+    unsigned bits;
+    memcpy(&bits, &v, sizeof(bits));
+    unsigned sign = bits >> 16 & 0x8000;
+    int exp = (int) (bits >> 23 & 0xFF) - 127 + 15;
+    unsigned mant = bits & 0x7FFFFF;
+
+    // NaN stays a quiet NaN, keeping what of the payload fits
+    if ((bits & 0x7F800000) == 0x7F800000 && mant)
+        return (unsigned short) (sign | 0x7E00 | mant >> 13);
+    if (exp >= 31)
+        return (unsigned short) (sign | 0x7C00);
+
+    unsigned shift = 13;
+    unsigned half;
+    if (exp <= 0)
+    {
+        // subnormal, or too small for a half
+        if (exp < -10)
+            return (unsigned short) sign;
+        mant |= 0x800000;
+        shift = 14 - exp;
+        half = mant >> shift;
+    }
+    else
+        half = exp << 10 | mant >> 13;
+
+    // round to nearest, ties to even; a carry out of the mantissa rounds up
+    // into the exponent (or from the largest half to infinity), as it should
+    unsigned rest = mant & ((1u << shift) - 1);
+    unsigned halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1)))
+        ++half;
+    return (unsigned short) (sign | half);
+}
+
+void gatherHeights(float *dst, const Vertex *src, unsigned begin, unsigned end)
+{
+    for (unsigned i = begin; i < end; ++i)
+        dst[i] = src[i].r.y;
+}
+
+void gatherHalfHeights(unsigned short *dst, const Vertex *src, unsigned begin, unsigned end)
+{
+    for (unsigned i = begin; i < end; ++i)
+        dst[i] = floatToHalf(src[i].r.y);
+}
@@ -0,0 +1,56 @@
+#ifndef TOWERDEFENSESDL_PACKEDVERTEX_H
+#define TOWERDEFENSESDL_PACKEDVERTEX_H
+
+#include "wave.h"
+
+/*
+ * Compact vertex for the VBO path, 12 bytes instead of the 36 of Vertex
+ * (the unused color is dropped).
+ *
+ * glVertexPointer takes one type for all components, so x, y and z are
+ * 16-bit fixed point with a common scale instead of 16-bit x/z plus a half
+ * float height: PACKED_POSITION_SCALE units per step covers +-4 at 1.2e-4
+ * resolution, the grid is [-1, 1] and the waves stay well inside. The
+ * normal is GL_INT_2_10_10_10_REV where supported (GL 3.3), else three
+ * signed bytes; both are normalized by GL and fill the same 4 bytes.
+ */
+
+typedef struct {
+    short x, y, z, pad;
+    unsigned n;
+} PackedVertex;
+
+static_assert(sizeof(PackedVertex) == 12, "PackedVertex must stay 12 bytes");
+
+const float PACKED_POSITION_SCALE = 1.0f / 8192;
+
+extern bool packedNormal1010102;    // normal encoding, set once the GL context is up
+
+// pack vertices [begin, end) of src into dst
+void packVertices(PackedVertex *dst, const Vertex *src, unsigned begin, unsigned end);
+
+/*
+ * Split streams: x/z never change, so they live in a static buffer written
+ * once, and the frame only streams the 8 bytes the sine waves change.
+ */
+
+typedef struct {
+    float x, z;
+} StaticXZ;
+
+typedef struct {
+    float y, nx;
+} HeightSlope;
+
+void gatherStaticXZ(StaticXZ *dst, const Vertex *src, unsigned begin, unsigned end);
+void gatherHeightSlope(HeightSlope *dst, const Vertex *src, unsigned begin, unsigned end);
+
+/*
+ * Heightmap texels: r.y alone, as float for R32F or IEEE half for R16F.
+ */
+
+unsigned short floatToHalf(float v);     // round to nearest even, overflow to infinity, NaN kept
+void gatherHeights(float *dst, const Vertex *src, unsigned begin, unsigned end);
+void gatherHalfHeights(unsigned short *dst, const Vertex *src, unsigned begin, unsigned end);
+
+#endif //TOWERDEFENSESDL_PACKEDVERTEX_H
@@ -0,0 +1,31 @@
+#ifndef TOWERDEFENSESDL_WAVE_H
+#define TOWERDEFENSESDL_WAVE_H
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+
+typedef struct {
+    float x, y;
+} vec2f;
+
+typedef struct {
+    float x, y, z;
+} vec3f;
+
+typedef struct {
+    glm::vec3 r, n, c;
+} Vertex;
+
+typedef struct {
+    float A;
+    float k;
+    float w;
+} sinewave;
+
+// Bands handed to the update threads are a multiple of this many vertices,
+// so two threads never write into the same cache line.
+const unsigned VERTEX_BAND_ALIGN = 16;
+static_assert(VERTEX_BAND_ALIGN * sizeof(Vertex) % 64 == 0, "bands must be cache-line multiples");
+
+#endif //TOWERDEFENSESDL_WAVE_H
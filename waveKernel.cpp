@@ -0,0 +1,1225 @@
+#include "waveKernel.h"
+#include "fastTrig.h"
+#include "Timer.h"
+#include "gridAlloc.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WAVE_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+WaveKernel waveKernel = KERNEL_SCALAR;
+WaveEval waveEval = EVAL_DIRECT;
+WaveModel waveModel = MODEL_SINE;
+float gerstnerSteepness = 0.15f;
+
+static const char *KERNEL_STRING[] = {
+        "SCALAR",
+        "SSE4.2",
+        "AVX2"
+};
+
+static const char *EVAL_STRING[] = {
+        "DIRECT",
+        "SEPARABLE",
+        "RECURRENCE"
+};
+
+static const char *MODEL_STRING[] = {
+        "SINE",
+        "GERSTNER"
+};
+
+// One wave prepared for the current frame. The phase of a vertex is
+// k * (x^2 + z^2) + wt, it contributes A * sin to y and nkA * cos to n.x.
+// The Gerstner model uses the last three factors instead of nkA.
+typedef struct {
+    float k;
+    float A;
+    float nkA;      // -k * A
+    float wt;       // w * time
+    float qA;       // Q * A
+    float qA2k;     // Q * A * 2k
+    float A2k;      // A * 2k
+} WaveTerm;
+
+// Per-vertex sums over the waves. The sine model only needs y and nx, the
+// Gerstner model the four sums its position and tangent frame are built
+// from (see storeGerstner())
+typedef struct {
+    float y;        // sum A sin
+    float nx;       // sum -kA cos
+    float hc;       // sum QA cos
+    float hs;       // sum QA 2k sin
+    float dc;       // sum A 2k cos
+} WaveSums;
+
+// cos/sin of k*x^2 per column and k*z^2 per row for every wave, stored
+// [column][wave] and [row][wave]; rebuilt when the grid, a k or the trig
+// tier changes
+static struct {
+    WaveGrid grid;
+    TrigTier tier;
+    std::vector<float> k;
+    std::vector<float> colCos, colSin;
+    std::vector<float> rowCos, rowSin;
+    std::vector<float> frameCos, frameSin;  // row phasors rotated by w*t
+} tables = {};
+
+// Per-vertex phasors for EVAL_RECURRENCE, stored [vertex][wave]
+static const float RECURRENCE_MAX_STEP = 0.5f;      // larger frame deltas re-seed exactly (s)
+static const unsigned RECURRENCE_RENORM = 64;       // renormalize every n steps
+static const unsigned RECURRENCE_RESYNC = 4096;     // re-seed every n steps to bound phase drift
+static struct {
+    bool valid;
+    unsigned count;
+    std::vector<sinewave> waves;
+    float time;
+    unsigned steps;
+    std::vector<float, GridAllocator<float> > cs, sn;
+} phasors = {};
+
+// Work shared by all updateWaveRange() calls of the current frame
+static struct {
+    WaveEval eval;
+    unsigned count;
+    float time;
+    std::vector<WaveTerm> terms;
+    WaveModel model;
+    WaveGrid grid;                          // layout of the array if it is the grid, or of the tiled grid
+    bool hasGrid;
+    bool seed;                              // recurrence: re-seed exactly this frame
+    bool renorm;                            // recurrence: renormalize this frame
+    std::vector<float> cr, sr;              // recurrence: rotation e^(i*w*dt) per wave
+} frame = {};
+
+// Vertex stride in floats, used to gather r.x/r.z out of the AoS array
+static const int VERTEX_STRIDE = sizeof(Vertex) / sizeof(float);
+
+// minimax coefficients on [-pi/4, pi/4] (Cephes sinf/cosf)
+static const float SIN_C1 = -1.6666654611e-1f;
+static const float SIN_C2 = 8.3321608736e-3f;
+static const float SIN_C3 = -1.9515295891e-4f;
+static const float COS_C1 = 4.166664568298827e-2f;
+static const float COS_C2 = -1.388731625493765e-3f;
+static const float COS_C3 = 2.443315711809948e-5f;
+
+
+static void prepareTerms(std::vector<WaveTerm> &terms, const sinewave *waves, unsigned nWaves, float time)
+{
+    terms.resize(nWaves);
+    for (unsigned i = 0; i < nWaves; ++i)
+    {
+        terms[i].k = waves[i].k;
+        terms[i].A = waves[i].A;
+        terms[i].nkA = -waves[i].k * waves[i].A;
+        terms[i].wt = waves[i].w * time;
+        terms[i].qA = gerstnerSteepness * waves[i].A;
+        terms[i].qA2k = gerstnerSteepness * waves[i].A * 2 * waves[i].k;
+        terms[i].A2k = waves[i].A * 2 * waves[i].k;
+    }
+}
+
+
+template <bool GERSTNER>
+static inline void addTerm(WaveSums &sum, const WaveTerm &t, float c, float s)
+{
+    sum.y += t.A * s;
+    if (GERSTNER)
+    {
+        sum.hc += t.qA * c;
+        sum.hs += t.qA2k * s;
+        sum.dc += t.A2k * c;
+    }
+    else
+        sum.nx += t.nkA * c;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gerstner vertex from the wave sums. Every wave moves the rest point
+// (x0, z0) radially by QA cos(theta) * (x0, z0), which stays smooth at the
+// centre. With S2 = sum QA cos, S3 = sum QA 2k sin, S4 = sum A 2k cos:
+//   P = (x0 (1 + S2), sum A sin, z0 (1 + S2))
+//   T = dP/dx0 = (1 + S2 - x0^2 S3, x0 S4, -x0 z0 S3)
+//   B = dP/dz0 = (-x0 z0 S3, z0 S4, 1 + S2 - z0^2 S3)
+//   N = B x T
+///////////////////////////////////////////////////////////////////////////////
+static inline void storeGerstner(Vertex &v, const WaveSums &sum, float x0, float z0)
+{
+    float d = 1 + sum.hc;
+    float xz = -x0 * z0 * sum.hs;
+    glm::vec3 T(d - x0 * x0 * sum.hs, x0 * sum.dc, xz);
+    glm::vec3 B(xz, z0 * sum.dc, d - z0 * z0 * sum.hs);
+
+    v.r = glm::vec3(x0 * d, sum.y, z0 * d);
+    v.n = glm::normalize(glm::cross(B, T));
+}
+
+template <bool GERSTNER>
+static inline void storeVertex(Vertex &v, const WaveSums &sum, float x0, float z0)
+{
+    if (GERSTNER)
+        storeGerstner(v, sum, x0, z0);
+    else
+    {
+        v.r.y = sum.y;
+        v.n.x = sum.nx;
+    }
+}
+
+// Walks the rest positions of consecutive vertices. With a grid they come
+// from its layout, since a Gerstner update displaces x/z of the array itself.
+struct RestCursor
+{
+    const Vertex *src;
+    const WaveGrid *grid;
+    unsigned idx, i, j;
+
+    RestCursor(const Vertex *src, const WaveGrid *grid, unsigned begin)
+            : src(src), grid(grid), idx(begin),
+              i(grid ? begin / (grid->rows + 1) : 0), j(grid ? begin % (grid->rows + 1) : 0)
+    {
+    }
+
+    inline void next(float *x0, float *z0)
+    {
+        if (grid)
+        {
+            *x0 = grid->x0 + i * grid->dx;
+            *z0 = grid->z0 + j * grid->dz;
+            if (++j > grid->rows)
+            {
+                j = 0;
+                ++i;
+            }
+        }
+        else
+        {
+            *x0 = src[idx].r.x;
+            *z0 = src[idx].r.z;
+        }
+        ++idx;
+    }
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// reference loop, one sin/cos of the selected trig tier per vertex and wave
+///////////////////////////////////////////////////////////////////////////////
+static void updateWaveScalar(Vertex *dst, const Vertex *src, unsigned count, const WaveTerm *terms, unsigned n)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        float x = src[i].r.x;
+        float z = src[i].r.z;
+        float r2 = x * x + z * z;
+        float y = 0, nx = 0;
+
+        for (unsigned w = 0; w < n; ++w)
+        {
+            float angle = terms[w].k * r2 + terms[w].wt;
+            float sn, cs;
+            trigSinCos(angle, &sn, &cs);
+            y += terms[w].A * sn;
+            nx += terms[w].nkA * cs;
+        }
+
+        dst[i].r.y = y;
+        dst[i].n.x = nx;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// the same loop over the structure-of-arrays mirror
+///////////////////////////////////////////////////////////////////////////////
+static void soaScalar(const float *xs, const float *zs, float *ys, float *nxs, unsigned count,
+                      const WaveTerm *terms, unsigned n)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        float r2 = xs[i] * xs[i] + zs[i] * zs[i];
+        float y = 0, nx = 0;
+
+        for (unsigned w = 0; w < n; ++w)
+        {
+            float sn, cs;
+            trigSinCos(terms[w].k * r2 + terms[w].wt, &sn, &cs);
+            y += terms[w].A * sn;
+            nx += terms[w].nkA * cs;
+        }
+
+        ys[i] = y;
+        nxs[i] = nx;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gerstner reference loop, sin/cos shared by position and tangent frame
+///////////////////////////////////////////////////////////////////////////////
+static void gerstnerScalar(Vertex *dst, RestCursor &rest, unsigned count, const WaveTerm *terms, unsigned n)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        float x0, z0;
+        rest.next(&x0, &z0);
+        float r2 = x0 * x0 + z0 * z0;
+        WaveSums sum = {0, 0, 0, 0, 0};
+
+        for (unsigned w = 0; w < n; ++w)
+        {
+            float angle = terms[w].k * r2 + terms[w].wt;
+            float sn, cs;
+            trigSinCos(angle, &sn, &cs);
+            addTerm<true>(sum, terms[w], cs, sn);
+        }
+
+        storeGerstner(dst[i], sum, x0, z0);
+    }
+}
+
+
+#ifdef WAVE_KERNEL_X86
+
+///////////////////////////////////////////////////////////////////////////////
+// 4-wide sin and cos of the same argument.
+// Reduce to [-pi/4, pi/4] by the nearest multiple of pi/2, evaluate both
+// polynomials and pick/negate them according to the quadrant.
+///////////////////////////////////////////////////////////////////////////////
+__attribute__((target("sse4.2")))
+static inline void sincos4(__m128 a, __m128 *s, __m128 *c)
+{
+    __m128 q = _mm_round_ps(_mm_mul_ps(a, _mm_set1_ps(TRIG_TWO_OVER_PI)),
+                            _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m128i qi = _mm_cvtps_epi32(q);
+
+    __m128 r = _mm_sub_ps(a, _mm_mul_ps(q, _mm_set1_ps(TRIG_PIO2_1)));
+    r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(TRIG_PIO2_2)));
+    r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(TRIG_PIO2_3)));
+    __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 ps = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_C3), r2), _mm_set1_ps(SIN_C2));
+    ps = _mm_add_ps(_mm_mul_ps(ps, r2), _mm_set1_ps(SIN_C1));
+    ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, r2), r), r);
+
+    __m128 pc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_C3), r2), _mm_set1_ps(COS_C2));
+    pc = _mm_add_ps(_mm_mul_ps(pc, r2), _mm_set1_ps(COS_C1));
+    pc = _mm_mul_ps(_mm_mul_ps(pc, r2), r2);
+    pc = _mm_add_ps(_mm_sub_ps(pc, _mm_mul_ps(r2, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+    // odd quadrants swap sin and cos
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(qi, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 sv = _mm_blendv_ps(ps, pc, swap);
+    __m128 cv = _mm_blendv_ps(pc, ps, swap);
+
+    // sin is negated in quadrants 2,3 and cos in quadrants 1,2
+    __m128 sSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(qi, _mm_set1_epi32(2)), 30));
+    __m128 cSign = _mm_castsi128_ps(_mm_slli_epi32(
+            _mm_and_si128(_mm_add_epi32(qi, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+    *s = _mm_xor_ps(sv, sSign);
+    *c = _mm_xor_ps(cv, cSign);
+}
+
+__attribute__((target("sse4.2")))
+static void updateWaveSSE42(Vertex *dst, const Vertex *src, unsigned count, const WaveTerm *terms, unsigned n)
+{
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const Vertex *v = src + i;
+        __m128 x0 = _mm_setr_ps(v[0].r.x, v[1].r.x, v[2].r.x, v[3].r.x);
+        __m128 z0 = _mm_setr_ps(v[0].r.z, v[1].r.z, v[2].r.z, v[3].r.z);
+        __m128 x1 = _mm_setr_ps(v[4].r.x, v[5].r.x, v[6].r.x, v[7].r.x);
+        __m128 z1 = _mm_setr_ps(v[4].r.z, v[5].r.z, v[6].r.z, v[7].r.z);
+        __m128 r0 = _mm_add_ps(_mm_mul_ps(x0, x0), _mm_mul_ps(z0, z0));
+        __m128 r1 = _mm_add_ps(_mm_mul_ps(x1, x1), _mm_mul_ps(z1, z1));
+
+        __m128 y0 = _mm_setzero_ps(), y1 = _mm_setzero_ps();
+        __m128 n0 = _mm_setzero_ps(), n1 = _mm_setzero_ps();
+
+        // all waves for these 8 vertices before touching the next ones
+        for (unsigned w = 0; w < n; ++w)
+        {
+            __m128 k = _mm_set1_ps(terms[w].k);
+            __m128 wt = _mm_set1_ps(terms[w].wt);
+            __m128 A = _mm_set1_ps(terms[w].A);
+            __m128 nkA = _mm_set1_ps(terms[w].nkA);
+
+            __m128 s0, c0, s1, c1;
+            sincos4(_mm_add_ps(_mm_mul_ps(k, r0), wt), &s0, &c0);
+            sincos4(_mm_add_ps(_mm_mul_ps(k, r1), wt), &s1, &c1);
+
+            y0 = _mm_add_ps(y0, _mm_mul_ps(A, s0));
+            y1 = _mm_add_ps(y1, _mm_mul_ps(A, s1));
+            n0 = _mm_add_ps(n0, _mm_mul_ps(nkA, c0));
+            n1 = _mm_add_ps(n1, _mm_mul_ps(nkA, c1));
+        }
+
+        alignas(16) float y[8], nx[8];
+        _mm_store_ps(y, y0);
+        _mm_store_ps(y + 4, y1);
+        _mm_store_ps(nx, n0);
+        _mm_store_ps(nx + 4, n1);
+
+        for (int l = 0; l < 8; ++l)
+        {
+            dst[i + l].r.y = y[l];
+            dst[i + l].n.x = nx[l];
+        }
+    }
+
+    updateWaveScalar(dst + i, src + i, count - i, terms, n);
+}
+
+__attribute__((target("sse4.2")))
+static void gerstnerSSE42(Vertex *dst, RestCursor &rest, unsigned count, const WaveTerm *terms, unsigned n)
+{
+    unsigned i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        alignas(16) float x0[4], z0[4];
+        for (int l = 0; l < 4; ++l)
+            rest.next(&x0[l], &z0[l]);
+        __m128 x = _mm_load_ps(x0);
+        __m128 z = _mm_load_ps(z0);
+        __m128 r2 = _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(z, z));
+
+        __m128 y = _mm_setzero_ps(), hc = _mm_setzero_ps();
+        __m128 hs = _mm_setzero_ps(), dc = _mm_setzero_ps();
+        for (unsigned w = 0; w < n; ++w)
+        {
+            __m128 s, c;
+            sincos4(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(terms[w].k), r2), _mm_set1_ps(terms[w].wt)), &s, &c);
+            y = _mm_add_ps(y, _mm_mul_ps(_mm_set1_ps(terms[w].A), s));
+            hc = _mm_add_ps(hc, _mm_mul_ps(_mm_set1_ps(terms[w].qA), c));
+            hs = _mm_add_ps(hs, _mm_mul_ps(_mm_set1_ps(terms[w].qA2k), s));
+            dc = _mm_add_ps(dc, _mm_mul_ps(_mm_set1_ps(terms[w].A2k), c));
+        }
+
+        alignas(16) float ys[4], hcs[4], hss[4], dcs[4];
+        _mm_store_ps(ys, y);
+        _mm_store_ps(hcs, hc);
+        _mm_store_ps(hss, hs);
+        _mm_store_ps(dcs, dc);
+        for (int l = 0; l < 4; ++l)
+        {
+            WaveSums sum = {ys[l], 0, hcs[l], hss[l], dcs[l]};
+            storeGerstner(dst[i + l], sum, x0[l], z0[l]);
+        }
+    }
+
+    gerstnerScalar(dst + i, rest, count - i, terms, n);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// 8-wide version of sincos4()
+///////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx2,fma")))
+static inline void sincos8(__m256 a, __m256 *s, __m256 *c)
+{
+    __m256 q = _mm256_round_ps(_mm256_mul_ps(a, _mm256_set1_ps(TRIG_TWO_OVER_PI)),
+                               _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256i qi = _mm256_cvtps_epi32(q);
+
+    __m256 r = _mm256_fnmadd_ps(q, _mm256_set1_ps(TRIG_PIO2_1), a);
+    r = _mm256_fnmadd_ps(q, _mm256_set1_ps(TRIG_PIO2_2), r);
+    r = _mm256_fnmadd_ps(q, _mm256_set1_ps(TRIG_PIO2_3), r);
+    __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 ps = _mm256_fmadd_ps(_mm256_set1_ps(SIN_C3), r2, _mm256_set1_ps(SIN_C2));
+    ps = _mm256_fmadd_ps(ps, r2, _mm256_set1_ps(SIN_C1));
+    ps = _mm256_fmadd_ps(_mm256_mul_ps(ps, r2), r, r);
+
+    __m256 pc = _mm256_fmadd_ps(_mm256_set1_ps(COS_C3), r2, _mm256_set1_ps(COS_C2));
+    pc = _mm256_fmadd_ps(pc, r2, _mm256_set1_ps(COS_C1));
+    pc = _mm256_mul_ps(_mm256_mul_ps(pc, r2), r2);
+    pc = _mm256_add_ps(_mm256_fnmadd_ps(r2, _mm256_set1_ps(0.5f), pc), _mm256_set1_ps(1.0f));
+
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+            _mm256_and_si256(qi, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    __m256 sv = _mm256_blendv_ps(ps, pc, swap);
+    __m256 cv = _mm256_blendv_ps(pc, ps, swap);
+
+    __m256 sSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(qi, _mm256_set1_epi32(2)), 30));
+    __m256 cSign = _mm256_castsi256_ps(_mm256_slli_epi32(
+            _mm256_and_si256(_mm256_add_epi32(qi, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+
+    *s = _mm256_xor_ps(sv, sSign);
+    *c = _mm256_xor_ps(cv, cSign);
+}
+
+__attribute__((target("avx2,fma")))
+static void updateWaveAVX2(Vertex *dst, const Vertex *src, unsigned count, const WaveTerm *terms, unsigned n)
+{
+    const __m256i offsets = _mm256_setr_epi32(0, VERTEX_STRIDE, 2 * VERTEX_STRIDE, 3 * VERTEX_STRIDE,
+                                              4 * VERTEX_STRIDE, 5 * VERTEX_STRIDE, 6 * VERTEX_STRIDE,
+                                              7 * VERTEX_STRIDE);
+
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const float *base = &src[i].r.x;
+        __m256 x = _mm256_i32gather_ps(base, offsets, 4);
+        __m256 z = _mm256_i32gather_ps(base + 2, offsets, 4);
+        __m256 r2 = _mm256_fmadd_ps(x, x, _mm256_mul_ps(z, z));
+
+        __m256 y = _mm256_setzero_ps();
+        __m256 nx = _mm256_setzero_ps();
+
+        // all waves for these 8 vertices before touching the next ones
+        for (unsigned w = 0; w < n; ++w)
+        {
+            __m256 angle = _mm256_fmadd_ps(_mm256_set1_ps(terms[w].k), r2, _mm256_set1_ps(terms[w].wt));
+
+            __m256 s, c;
+            sincos8(angle, &s, &c);
+
+            y = _mm256_fmadd_ps(_mm256_set1_ps(terms[w].A), s, y);
+            nx = _mm256_fmadd_ps(_mm256_set1_ps(terms[w].nkA), c, nx);
+        }
+
+        alignas(32) float ys[8], ns[8];
+        _mm256_store_ps(ys, y);
+        _mm256_store_ps(ns, nx);
+
+        for (int l = 0; l < 8; ++l)
+        {
+            dst[i + l].r.y = ys[l];
+            dst[i + l].n.x = ns[l];
+        }
+    }
+
+    updateWaveScalar(dst + i, src + i, count - i, terms, n);
+}
+
+__attribute__((target("avx2,fma")))
+static void gerstnerAVX2(Vertex *dst, RestCursor &rest, unsigned count, const WaveTerm *terms, unsigned n)
+{
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        alignas(32) float x0[8], z0[8];
+        for (int l = 0; l < 8; ++l)
+            rest.next(&x0[l], &z0[l]);
+        __m256 x = _mm256_load_ps(x0);
+        __m256 z = _mm256_load_ps(z0);
+        __m256 r2 = _mm256_fmadd_ps(x, x, _mm256_mul_ps(z, z));
+
+        __m256 y = _mm256_setzero_ps(), hc = _mm256_setzero_ps();
+        __m256 hs = _mm256_setzero_ps(), dc = _mm256_setzero_ps();
+        for (unsigned w = 0; w < n; ++w)
+        {
+            __m256 s, c;
+            sincos8(_mm256_fmadd_ps(_mm256_set1_ps(terms[w].k), r2, _mm256_set1_ps(terms[w].wt)), &s, &c);
+            y = _mm256_fmadd_ps(_mm256_set1_ps(terms[w].A), s, y);
+            hc = _mm256_fmadd_ps(_mm256_set1_ps(terms[w].qA), c, hc);
+            hs = _mm256_fmadd_ps(_mm256_set1_ps(terms[w].qA2k), s, hs);
+            dc = _mm256_fmadd_ps(_mm256_set1_ps(terms[w].A2k), c, dc);
+        }
+
+        alignas(32) float ys[8], hcs[8], hss[8], dcs[8];
+        _mm256_store_ps(ys, y);
+        _mm256_store_ps(hcs, hc);
+        _mm256_store_ps(hss, hs);
+        _mm256_store_ps(dcs, dc);
+        for (int l = 0; l < 8; ++l)
+        {
+            WaveSums sum = {ys[l], 0, hcs[l], hss[l], dcs[l]};
+            storeGerstner(dst[i + l], sum, x0[l], z0[l]);
+        }
+    }
+
+    gerstnerScalar(dst + i, rest, count - i, terms, n);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SoA kernels: x/z come in with one load per register instead of the
+// setr/gather of the AoS kernels, y/nx go out with one store each
+///////////////////////////////////////////////////////////////////////////////
+__attribute__((target("sse4.2")))
+static void soaSSE42(const float *xs, const float *zs, float *ys, float *nxs, unsigned count,
+                     const WaveTerm *terms, unsigned n)
+{
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 x0 = _mm_loadu_ps(xs + i), x1 = _mm_loadu_ps(xs + i + 4);
+        __m128 z0 = _mm_loadu_ps(zs + i), z1 = _mm_loadu_ps(zs + i + 4);
+        __m128 r0 = _mm_add_ps(_mm_mul_ps(x0, x0), _mm_mul_ps(z0, z0));
+        __m128 r1 = _mm_add_ps(_mm_mul_ps(x1, x1), _mm_mul_ps(z1, z1));
+
+        __m128 y0 = _mm_setzero_ps(), y1 = _mm_setzero_ps();
+        __m128 n0 = _mm_setzero_ps(), n1 = _mm_setzero_ps();
+        for (unsigned w = 0; w < n; ++w)
+        {
+            __m128 k = _mm_set1_ps(terms[w].k);
+            __m128 wt = _mm_set1_ps(terms[w].wt);
+            __m128 A = _mm_set1_ps(terms[w].A);
+            __m128 nkA = _mm_set1_ps(terms[w].nkA);
+
+            __m128 s0, c0, s1, c1;
+            sincos4(_mm_add_ps(_mm_mul_ps(k, r0), wt), &s0, &c0);
+            sincos4(_mm_add_ps(_mm_mul_ps(k, r1), wt), &s1, &c1);
+
+            y0 = _mm_add_ps(y0, _mm_mul_ps(A, s0));
+            y1 = _mm_add_ps(y1, _mm_mul_ps(A, s1));
+            n0 = _mm_add_ps(n0, _mm_mul_ps(nkA, c0));
+            n1 = _mm_add_ps(n1, _mm_mul_ps(nkA, c1));
+        }
+
+        _mm_storeu_ps(ys + i, y0);
+        _mm_storeu_ps(ys + i + 4, y1);
+        _mm_storeu_ps(nxs + i, n0);
+        _mm_storeu_ps(nxs + i + 4, n1);
+    }
+
+    soaScalar(xs + i, zs + i, ys + i, nxs + i, count - i, terms, n);
+}
+
+__attribute__((target("avx2,fma")))
+static void soaAVX2(const float *xs, const float *zs, float *ys, float *nxs, unsigned count,
+                    const WaveTerm *terms, unsigned n)
+{
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(xs + i);
+        __m256 z = _mm256_loadu_ps(zs + i);
+        __m256 r2 = _mm256_fmadd_ps(x, x, _mm256_mul_ps(z, z));
+
+        __m256 y = _mm256_setzero_ps();
+        __m256 nx = _mm256_setzero_ps();
+        for (unsigned w = 0; w < n; ++w)
+        {
+            __m256 s, c;
+            sincos8(_mm256_fmadd_ps(_mm256_set1_ps(terms[w].k), r2, _mm256_set1_ps(terms[w].wt)), &s, &c);
+            y = _mm256_fmadd_ps(_mm256_set1_ps(terms[w].A), s, y);
+            nx = _mm256_fmadd_ps(_mm256_set1_ps(terms[w].nkA), c, nx);
+        }
+
+        _mm256_storeu_ps(ys + i, y);
+        _mm256_storeu_ps(nxs + i, nx);
+    }
+
+    soaScalar(xs + i, zs + i, ys + i, nxs + i, count - i, terms, n);
+}
+
+#endif // WAVE_KERNEL_X86
+
+
+WaveKernel detectWaveKernel()
+{
+    if (waveKernelSupported(KERNEL_AVX2))
+        return KERNEL_AVX2;
+    if (waveKernelSupported(KERNEL_SSE42))
+        return KERNEL_SSE42;
+    return KERNEL_SCALAR;
+}
+
+bool waveKernelSupported(WaveKernel kernel)
+{
+    switch (kernel)
+    {
+        case KERNEL_SCALAR:
+            return true;
+#ifdef WAVE_KERNEL_X86
+        case KERNEL_SSE42:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.2");
+        case KERNEL_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char *waveKernelName(WaveKernel kernel)
+{
+    return kernel < nKernel ? KERNEL_STRING[kernel] : "UNKNOWN";
+}
+
+const char *waveEvalName(WaveEval eval)
+{
+    return eval < nEval ? EVAL_STRING[eval] : "UNKNOWN";
+}
+
+const char *waveModelName(WaveModel model)
+{
+    return model < nModel ? MODEL_STRING[model] : "UNKNOWN";
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// evaluate prepared waves for vertices [begin, end) with the selected kernel.
+// grid (may be NULL) supplies the rest positions for the Gerstner model.
+///////////////////////////////////////////////////////////////////////////////
+static void batchTerms(Vertex *dst, const Vertex *src, unsigned begin, unsigned end,
+                       const WaveTerm *terms, unsigned n, WaveModel model, const WaveGrid *grid)
+{
+    unsigned count = end - begin;
+
+    if (model == MODEL_GERSTNER)
+    {
+        RestCursor rest(src, grid, begin);
+        switch (waveKernel)
+        {
+#ifdef WAVE_KERNEL_X86
+            case KERNEL_AVX2:
+                gerstnerAVX2(dst + begin, rest, count, terms, n);
+                break;
+            case KERNEL_SSE42:
+                gerstnerSSE42(dst + begin, rest, count, terms, n);
+                break;
+#endif
+            default:
+                gerstnerScalar(dst + begin, rest, count, terms, n);
+                break;
+        }
+        return;
+    }
+
+    dst += begin;
+    src += begin;
+    switch (waveKernel)
+    {
+#ifdef WAVE_KERNEL_X86
+        case KERNEL_AVX2:
+            updateWaveAVX2(dst, src, count, terms, n);
+            break;
+        case KERNEL_SSE42:
+            updateWaveSSE42(dst, src, count, terms, n);
+            break;
+#endif
+        default:
+            updateWaveScalar(dst, src, count, terms, n);
+            break;
+    }
+}
+
+
+static bool sameGrid(const WaveGrid *a, const WaveGrid *b)
+{
+    return a->rows == b->rows && a->cols == b->cols &&
+           a->x0 == b->x0 && a->z0 == b->z0 && a->dx == b->dx && a->dz == b->dz;
+}
+
+static bool sameK(const std::vector<float> &k, const sinewave *waves, unsigned nWaves)
+{
+    if (k.size() != nWaves)
+        return false;
+    for (unsigned w = 0; w < nWaves; ++w)
+        if (k[w] != waves[w].k)
+            return false;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// fill the per-column and per-row phasor tables, O(waves * (rows + cols))
+// sin/cos
+///////////////////////////////////////////////////////////////////////////////
+static void buildPhasorTables(const WaveGrid *grid, const sinewave *waves, unsigned nWaves)
+{
+    tables.grid = *grid;
+    tables.tier = trigTier;
+    tables.k.resize(nWaves);
+    for (unsigned w = 0; w < nWaves; ++w)
+        tables.k[w] = waves[w].k;
+
+    tables.colCos.resize((grid->cols + 1) * nWaves);
+    tables.colSin.resize((grid->cols + 1) * nWaves);
+    for (unsigned i = 0; i <= grid->cols; ++i)
+    {
+        float x = grid->x0 + i * grid->dx;
+        for (unsigned w = 0; w < nWaves; ++w)
+        {
+            trigSinCos(waves[w].k * x * x, &tables.colSin[i * nWaves + w], &tables.colCos[i * nWaves + w]);
+        }
+    }
+
+    tables.rowCos.resize((grid->rows + 1) * nWaves);
+    tables.rowSin.resize((grid->rows + 1) * nWaves);
+    tables.frameCos.resize((grid->rows + 1) * nWaves);
+    tables.frameSin.resize((grid->rows + 1) * nWaves);
+    for (unsigned j = 0; j <= grid->rows; ++j)
+    {
+        float z = grid->z0 + j * grid->dz;
+        for (unsigned w = 0; w < nWaves; ++w)
+        {
+            trigSinCos(waves[w].k * z * z, &tables.rowSin[j * nWaves + w], &tables.rowCos[j * nWaves + w]);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// once per frame: rotate the row factors by w*t of their wave
+///////////////////////////////////////////////////////////////////////////////
+static void beginGrid(const WaveGrid *grid, const sinewave *waves, unsigned nWaves, float time)
+{
+    if (!sameK(tables.k, waves, nWaves) || !sameGrid(&tables.grid, grid) || tables.tier != trigTier ||
+        tables.colCos.empty())
+        buildPhasorTables(grid, waves, nWaves);
+
+    // once per wave and frame, libm is cheap enough here
+    std::vector<float> ct(nWaves), st(nWaves);
+    for (unsigned w = 0; w < nWaves; ++w)
+    {
+        ct[w] = cosf(waves[w].w * time);
+        st[w] = sinf(waves[w].w * time);
+    }
+
+    float *rc = tables.frameCos.data();
+    float *rs = tables.frameSin.data();
+    for (unsigned j = 0, t = 0; j <= grid->rows; ++j)
+    {
+        for (unsigned w = 0; w < nWaves; ++w, ++t)
+        {
+            rc[t] = tables.rowCos[t] * ct[w] - tables.rowSin[t] * st[w];
+            rs[t] = tables.rowSin[t] * ct[w] + tables.rowCos[t] * st[w];
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// evaluate the waves over a structured grid without per-vertex trig:
+//   e^(i(kx^2 + kz^2 + wt)) = e^(i kx^2) * (e^(i kz^2) * e^(i wt))
+// The row factors were rotated by beginGrid(), so each vertex and wave is
+// one complex multiply. tile is a tile of the grid in the tables, the
+// whole grid when updateWaveRange() calls; dst is vertex begin of it.
+///////////////////////////////////////////////////////////////////////////////
+template <bool GERSTNER>
+static void gridRange(Vertex *dst, const WaveTile &tile, unsigned begin, unsigned end)
+{
+    const WaveGrid &grid = tables.grid;
+    unsigned rowCount = tile.rows + 1;
+    unsigned n = (unsigned) frame.terms.size();
+    const WaveTerm *terms = frame.terms.data();
+    const float *rc = tables.frameCos.data();
+    const float *rs = tables.frameSin.data();
+
+    unsigned a = begin / rowCount;
+    unsigned b = begin % rowCount;
+    for (unsigned idx = begin; idx < end; ++a, b = 0)
+    {
+        unsigned i = tile.i0 + (a < tile.lastI ? a : tile.lastI);
+        const float *ci = &tables.colCos[(size_t) i * n];
+        const float *si = &tables.colSin[(size_t) i * n];
+        float x0 = grid.x0 + i * grid.dx;
+        unsigned last = rowCount - b < end - idx ? rowCount : b + (end - idx);
+        for (; b < last; ++b, ++idx)
+        {
+            unsigned j = tile.j0 + (b < tile.lastJ ? b : tile.lastJ);
+            const float *cj = rc + (size_t) j * n;
+            const float *sj = rs + (size_t) j * n;
+            WaveSums sum = {0, 0, 0, 0, 0};
+            for (unsigned w = 0; w < n; ++w)
+                addTerm<GERSTNER>(sum, terms[w], ci[w] * cj[w] - si[w] * sj[w], si[w] * cj[w] + ci[w] * sj[w]);
+            storeVertex<GERSTNER>(dst[idx - begin], sum, x0, grid.z0 + j * grid.dz);
+        }
+    }
+}
+
+
+void resetWaveRecurrence()
+{
+    phasors.valid = false;
+}
+
+static bool sameWaves(const std::vector<sinewave> &a, const sinewave *waves, unsigned nWaves)
+{
+    if (a.size() != nWaves)
+        return false;
+    for (unsigned w = 0; w < nWaves; ++w)
+        if (a[w].A != waves[w].A || a[w].k != waves[w].k || a[w].w != waves[w].w)
+            return false;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// once per frame: decide between an exact re-seed and a rotation step
+///////////////////////////////////////////////////////////////////////////////
+static void beginRecurrence(unsigned count, const sinewave *waves, unsigned nWaves, float time)
+{
+    float dt = time - phasors.time;
+    frame.seed = !phasors.valid || phasors.count != count || !sameWaves(phasors.waves, waves, nWaves) ||
+                 dt < 0 || dt > RECURRENCE_MAX_STEP || phasors.steps >= RECURRENCE_RESYNC;
+
+    if (frame.seed)
+    {
+        phasors.cs.resize((size_t) count * nWaves);
+        phasors.sn.resize((size_t) count * nWaves);
+        phasors.valid = true;
+        phasors.count = count;
+        phasors.waves.assign(waves, waves + nWaves);
+        phasors.steps = 0;
+        frame.renorm = false;
+    }
+    else
+    {
+        frame.cr.resize(nWaves);
+        frame.sr.resize(nWaves);
+        for (unsigned w = 0; w < nWaves; ++w)
+        {
+            frame.cr[w] = cosf(waves[w].w * dt);
+            frame.sr[w] = sinf(waves[w].w * dt);
+        }
+        frame.renorm = ++phasors.steps % RECURRENCE_RENORM == 0;
+    }
+    phasors.time = time;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// seed with exact sin/cos, or advance every phasor by e^(i*w*dt) which is a
+// 2x2 multiply-add per vertex and wave
+///////////////////////////////////////////////////////////////////////////////
+template <bool GERSTNER>
+static void recurrenceRange(Vertex *dst, const Vertex *src, unsigned begin, unsigned end)
+{
+    unsigned n = (unsigned) frame.terms.size();
+    const WaveTerm *terms = frame.terms.data();
+    RestCursor rest(src, frame.hasGrid ? &frame.grid : NULL, begin);
+
+    if (frame.seed)
+    {
+        for (unsigned i = begin; i < end; ++i)
+        {
+            float x0, z0;
+            rest.next(&x0, &z0);
+            float r2 = x0 * x0 + z0 * z0;
+            float *cs = &phasors.cs[(size_t) i * n];
+            float *sn = &phasors.sn[(size_t) i * n];
+            WaveSums sum = {0, 0, 0, 0, 0};
+            for (unsigned w = 0; w < n; ++w)
+            {
+                float angle = terms[w].k * r2 + terms[w].wt;
+                trigSinCos(angle, &sn[w], &cs[w]);
+                addTerm<GERSTNER>(sum, terms[w], cs[w], sn[w]);
+            }
+            storeVertex<GERSTNER>(dst[i], sum, x0, z0);
+        }
+        return;
+    }
+
+    const float *cr = frame.cr.data();
+    const float *sr = frame.sr.data();
+    bool renorm = frame.renorm;
+    for (unsigned i = begin; i < end; ++i)
+    {
+        float x0, z0;
+        rest.next(&x0, &z0);
+        float *cs = &phasors.cs[(size_t) i * n];
+        float *sn = &phasors.sn[(size_t) i * n];
+        WaveSums sum = {0, 0, 0, 0, 0};
+        for (unsigned w = 0; w < n; ++w)
+        {
+            float c = cs[w] * cr[w] - sn[w] * sr[w];
+            float s = sn[w] * cr[w] + cs[w] * sr[w];
+            if (renorm)
+            {
+                // one Newton step towards |p| = 1, enough since the error is tiny
+                float scale = 1.5f - 0.5f * (c * c + s * s);
+                c *= scale;
+                s *= scale;
+            }
+            cs[w] = c;
+            sn[w] = s;
+            addTerm<GERSTNER>(sum, terms[w], c, s);
+        }
+        storeVertex<GERSTNER>(dst[i], sum, x0, z0);
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// once-per-frame part of the update, must run before updateWaveRange()
+///////////////////////////////////////////////////////////////////////////////
+void beginWaveUpdateWith(WaveEval eval, unsigned count, const WaveGrid *grid,
+                         const sinewave *waves, unsigned nWaves, float time)
+{
+    frame.hasGrid = grid && count == (grid->rows + 1) * (grid->cols + 1);
+    if (frame.hasGrid)
+        frame.grid = *grid;
+    if (eval == EVAL_SEPARABLE && !frame.hasGrid)
+        eval = EVAL_DIRECT;
+
+    frame.eval = eval;
+    frame.model = waveModel;
+    frame.count = count;
+    frame.time = time;
+    prepareTerms(frame.terms, waves, nWaves, time);
+
+    if (eval == EVAL_SEPARABLE)
+        beginGrid(grid, waves, nWaves, time);
+    else if (eval == EVAL_RECURRENCE)
+        beginRecurrence(count, waves, nWaves, time);
+}
+
+void beginWaveUpdate(unsigned count, const WaveGrid *grid, const sinewave *waves, unsigned nWaves, float time)
+{
+    beginWaveUpdateWith(waveEval, count, grid, waves, nWaves, time);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// evaluate vertices [begin, end) of the frame set up by beginWaveUpdate()
+///////////////////////////////////////////////////////////////////////////////
+void updateWaveRange(Vertex *dst, const Vertex *src, unsigned begin, unsigned end)
+{
+    if (!dst || !src || end > frame.count || begin >= end)
+        return;
+
+    bool gerstner = frame.model == MODEL_GERSTNER;
+    switch (frame.eval)
+    {
+        case EVAL_SEPARABLE:
+        {
+            const WaveGrid &grid = tables.grid;
+            WaveTile whole = {0, 0, grid.rows, grid.cols, grid.cols, grid.rows};
+            if (gerstner)
+                gridRange<true>(dst + begin, whole, begin, end);
+            else
+                gridRange<false>(dst + begin, whole, begin, end);
+            break;
+        }
+        case EVAL_RECURRENCE:
+            if (gerstner)
+                recurrenceRange<true>(dst, src, begin, end);
+            else
+                recurrenceRange<false>(dst, src, begin, end);
+            break;
+        default:
+            batchTerms(dst, src, begin, end, frame.terms.data(), (unsigned) frame.terms.size(),
+                       frame.model, frame.hasGrid ? &frame.grid : NULL);
+            break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// once per frame for all tiles of grid. The tiles are not the grid, so
+// hasGrid stays off; updateWaveTileRange() places their vertices itself
+///////////////////////////////////////////////////////////////////////////////
+void beginWaveTiles(WaveEval eval, const WaveGrid *grid, const sinewave *waves, unsigned nWaves, float time)
+{
+    frame.hasGrid = false;
+    frame.grid = *grid;
+    frame.eval = eval == EVAL_SEPARABLE && grid ? EVAL_SEPARABLE : EVAL_DIRECT;
+    frame.model = waveModel;
+    frame.count = 0;
+    frame.time = time;
+    prepareTerms(frame.terms, waves, nWaves, time);
+
+    if (frame.eval == EVAL_SEPARABLE)
+        beginGrid(grid, waves, nWaves, time);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// evaluate vertices [begin, end) of tile, set up by beginWaveTiles(). Runs
+// in chunks small enough for the cache: the flat rest positions are laid
+// out from the tile's place in the grid, the waves evaluated over them in
+// place, and the finished vertices copied to dst in one write-only stream.
+///////////////////////////////////////////////////////////////////////////////
+static const unsigned TILE_CHUNK = 256;
+
+void updateWaveTileRange(Vertex *dst, const WaveTile *tile, unsigned begin, unsigned end)
+{
+    if (!dst || !tile || end > (tile->rows + 1) * (tile->cols + 1) || begin >= end)
+        return;
+
+    const WaveGrid &grid = frame.grid;
+    unsigned rowCount = tile->rows + 1;
+    bool gerstner = frame.model == MODEL_GERSTNER;
+    Vertex chunk[TILE_CHUNK];
+
+    unsigned a = begin / rowCount;
+    unsigned b = begin % rowCount;
+    for (unsigned first = begin; first < end; first += TILE_CHUNK)
+    {
+        unsigned count = end - first < TILE_CHUNK ? end - first : TILE_CHUNK;
+        // positions from the global column and row, so both tiles on an
+        // edge put its vertices at exactly the same place
+        for (unsigned k = 0; k < count; ++k)
+        {
+            unsigned i = tile->i0 + (a < tile->lastI ? a : tile->lastI);
+            unsigned j = tile->j0 + (b < tile->lastJ ? b : tile->lastJ);
+            chunk[k].r = {grid.x0 + i * grid.dx, 0, grid.z0 + j * grid.dz};
+            chunk[k].n = {0, 1.0f, 0};
+            chunk[k].c = {0, 0, 0};
+            if (++b == rowCount)
+            {
+                b = 0;
+                ++a;
+            }
+        }
+
+        if (frame.eval == EVAL_SEPARABLE)
+        {
+            if (gerstner)
+                gridRange<true>(chunk, *tile, first, first + count);
+            else
+                gridRange<false>(chunk, *tile, first, first + count);
+        }
+        else
+        {
+            batchTerms(chunk, chunk, 0, count, frame.terms.data(), (unsigned) frame.terms.size(), frame.model, NULL);
+        }
+        memcpy(dst + first, chunk, count * sizeof(Vertex));
+    }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// structure-of-arrays mirror. The four arrays share one grid block, each
+// padded to a whole number of cache lines.
+///////////////////////////////////////////////////////////////////////////////
+static const unsigned SOA_LINE = GRID_ALIGN / sizeof(float);
+
+void freeWaveSoA(WaveSoA *soa)
+{
+    gridFree(soa->x);
+    soa->x = soa->z = soa->y = soa->nx = NULL;
+    soa->count = soa->capacity = 0;
+}
+
+void loadWaveSoA(WaveSoA *soa, const Vertex *src, unsigned count)
+{
+    if (!src || !count)
+    {
+        soa->count = 0;
+        return;
+    }
+
+    if (count > soa->capacity)
+    {
+        unsigned capacity = (unsigned) gridGrowCapacity(soa->capacity, count);
+        size_t stride = (capacity + SOA_LINE - 1) / SOA_LINE * SOA_LINE;
+        freeWaveSoA(soa);
+        float *block = (float *) gridAlloc(4 * stride * sizeof(float));
+        if (!block)
+            return;
+
+        soa->x = block;
+        soa->z = soa->x + stride;
+        soa->y = soa->z + stride;
+        soa->nx = soa->y + stride;
+        soa->capacity = capacity;
+    }
+
+    soa->count = count;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        soa->x[i] = src[i].r.x;
+        soa->z[i] = src[i].r.z;
+        soa->y[i] = src[i].r.y;
+        soa->nx[i] = src[i].n.x;
+    }
+}
+
+static void soaTerms(WaveSoA *soa, unsigned begin, unsigned end, const WaveTerm *terms, unsigned n)
+{
+    const float *x = soa->x + begin, *z = soa->z + begin;
+    float *y = soa->y + begin, *nx = soa->nx + begin;
+    unsigned count = end - begin;
+    switch (waveKernel)
+    {
+#ifdef WAVE_KERNEL_X86
+        case KERNEL_AVX2:
+            soaAVX2(x, z, y, nx, count, terms, n);
+            break;
+        case KERNEL_SSE42:
+            soaSSE42(x, z, y, nx, count, terms, n);
+            break;
+#endif
+        default:
+            soaScalar(x, z, y, nx, count, terms, n);
+            break;
+    }
+}
+
+static void scatterSoA(Vertex *dst, const WaveSoA *soa, unsigned begin, unsigned end)
+{
+    for (unsigned i = begin; i < end; ++i)
+    {
+        dst[i].r.y = soa->y[i];
+        dst[i].n.x = soa->nx[i];
+    }
+}
+
+void updateWaveSoARange(WaveSoA *soa, Vertex *dst, const Vertex *src, unsigned begin, unsigned end)
+{
+    if (!soa || soa->count != frame.count || frame.eval != EVAL_DIRECT || frame.model != MODEL_SINE)
+    {
+        updateWaveRange(dst, src, begin, end);
+        return;
+    }
+    if (!dst || end > frame.count || begin >= end)
+        return;
+
+    soaTerms(soa, begin, end, frame.terms.data(), (unsigned) frame.terms.size());
+    scatterSoA(dst, soa, begin, end);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// single threaded so only the layout differs; every variant runs a few times
+// over the whole array and the fastest run counts
+///////////////////////////////////////////////////////////////////////////////
+void benchWaveLayout(const Vertex *src, unsigned count, const sinewave *waves, unsigned nWaves)
+{
+    if (!src || !count || !nWaves)
+        return;
+
+    std::vector<Vertex> dst(src, src + count);
+    WaveSoA soa = {NULL, NULL, NULL, NULL, 0, 0};
+    loadWaveSoA(&soa, src, count);
+    if (!soa.count)
+        return;
+
+    std::vector<WaveTerm> terms;
+    prepareTerms(terms, waves, nWaves, 1.0f);
+    const int RUNS = 5;
+    double scale = 1000.0 / ((double) count * nWaves);
+
+    printf("layout bench: %u vertices, %u waves, ns per vertex and wave (best of %d)\n", count, nWaves, RUNS);
+    printf("%-8s %10s %10s %14s %8s\n", "kernel", "AoS", "SoA", "SoA+scatter", "gain");
+    WaveKernel saved = waveKernel;
+    for (int k = 0; k < nKernel; ++k)
+    {
+        if (!waveKernelSupported((WaveKernel) k))
+            continue;
+        waveKernel = (WaveKernel) k;
+
+        double aos = 1e30, soaOnly = 1e30, soaScatter = 1e30;
+        for (int run = 0; run < RUNS; ++run)
+        {
+            Timer timer;
+            timer.start();
+            batchTerms(dst.data(), src, 0, count, terms.data(), nWaves, MODEL_SINE, NULL);
+            timer.stop();
+            if (timer.getElapsedTimeInMicroSec() < aos)
+                aos = timer.getElapsedTimeInMicroSec();
+
+            timer.start();
+            soaTerms(&soa, 0, count, terms.data(), nWaves);
+            timer.stop();
+            if (timer.getElapsedTimeInMicroSec() < soaOnly)
+                soaOnly = timer.getElapsedTimeInMicroSec();
+
+            timer.start();
+            soaTerms(&soa, 0, count, terms.data(), nWaves);
+            scatterSoA(dst.data(), &soa, 0, count);
+            timer.stop();
+            if (timer.getElapsedTimeInMicroSec() < soaScatter)
+                soaScatter = timer.getElapsedTimeInMicroSec();
+        }
+
+        printf("%-8s %10.3f %10.3f %14.3f %7.2fx\n", waveKernelName(waveKernel),
+               aos * scale, soaOnly * scale, soaScatter * scale, soaScatter > 0 ? aos / soaScatter : 0.0);
+    }
+    waveKernel = saved;
+    freeWaveSoA(&soa);
+}
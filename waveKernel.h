@@ -0,0 +1,139 @@
+#ifndef TOWERDEFENSESDL_WAVEKERNEL_H
+#define TOWERDEFENSESDL_WAVEKERNEL_H
+
+#include "wave.h"
+
+/*
+ * Batch update engine for the sine waves.
+ *
+ * An update is split in two: beginWaveUpdate() does the once-per-frame work
+ * on one thread (the per-wave terms, the phasor tables, the recurrence
+ * step), then updateWaveRange() evaluates the sum of the waves for any
+ * number of disjoint vertex ranges, concurrently on the thread pool,
+ * writing r.y and n.x of dst from r.x and r.z of src (dst may equal src).
+ *
+ * EVAL_DIRECT keeps the wave loop innermost, so every vertex is read and
+ * written once no matter how many waves there are. Its kernel is picked at
+ * runtime: AVX2 (8 vertices per iteration), SSE4.2 (2 x 4 vertices per
+ * iteration) or the plain scalar loop. The scalar loop, the separable
+ * tables and the recurrence seeds take sin/cos from the trig tier selected
+ * in fastTrig.h; the SIMD kernels always use their own vectorized Cephes
+ * polynomial, which is about as accurate as TRIG_POLY9.
+ *
+ * For the structured grid built by computeAndStoreGrid2D() the phase
+ * k*x^2 + k*z^2 + w*t is separable, so EVAL_SEPARABLE rebuilds every vertex
+ * from per-column and per-row phasor tables with the angle-addition
+ * identities instead of calling sin/cos per vertex. Arrays that are not
+ * the grid passed to beginWaveUpdate() always go direct.
+ *
+ * EVAL_RECURRENCE keeps the unit phasor e^(i*angle) of every vertex and
+ * advances it each frame by the rotation e^(i*w*dt), so animated frames need
+ * no trig at all. The phasors are renormalized periodically and re-seeded
+ * exactly after a large time jump or resetWaveRecurrence().
+ *
+ * MODEL_GERSTNER turns every strategy into a trochoidal wave: besides the
+ * height, each wave moves the vertex horizontally and the full normal is
+ * built from the analytic tangent and binormal. The sin/cos of a wave are
+ * shared by position and normal. Rest positions come from the grid layout
+ * when there is one, otherwise from r.x/r.z of src.
+ */
+
+enum WaveKernel {
+    KERNEL_SCALAR = 0,
+    KERNEL_SSE42,
+    KERNEL_AVX2,
+    nKernel
+};
+
+enum WaveEval {
+    EVAL_DIRECT = 0,                // sin/cos per vertex with the selected kernel
+    EVAL_SEPARABLE,                 // per-row/per-column phasor tables
+    EVAL_RECURRENCE,                // per-vertex phasors stepped by the frame delta
+    nEval
+};
+
+enum WaveModel {
+    MODEL_SINE = 0,                 // writes r.y and n.x only
+    MODEL_GERSTNER,                 // writes r and n
+    nModel
+};
+
+// Structured grid: column i, row j is vertex i * (rows + 1) + j,
+// at x = x0 + i * dx, z = z0 + j * dz
+typedef struct {
+    unsigned rows, cols;
+    float x0, z0;
+    float dx, dz;
+} WaveGrid;
+
+extern WaveKernel waveKernel;       // kernel of EVAL_DIRECT
+extern WaveEval waveEval;           // strategy used by beginWaveUpdate()
+extern WaveModel waveModel;         // surface model used by every strategy
+extern float gerstnerSteepness;     // Q, horizontal displacement is Q * A per wave
+
+WaveKernel detectWaveKernel();      // best kernel supported by this CPU
+bool waveKernelSupported(WaveKernel kernel);
+const char *waveKernelName(WaveKernel kernel);
+const char *waveEvalName(WaveEval eval);
+const char *waveModelName(WaveModel model);
+
+// force the next recurrence step to re-seed from exact evaluation,
+// e.g. after unpausing or when the vertex array is rebuilt
+void resetWaveRecurrence();
+
+// Once-per-frame part of an update of count vertices with waveEval: the
+// tables, re-seed decision and frame rotation. grid may be NULL when the
+// array is not a structured grid.
+void beginWaveUpdate(unsigned count, const WaveGrid *grid, const sinewave *waves, unsigned nWaves, float time);
+// beginWaveUpdate() with eval instead of waveEval
+void beginWaveUpdateWith(WaveEval eval, unsigned count, const WaveGrid *grid,
+                         const sinewave *waves, unsigned nWaves, float time);
+// evaluate vertices [begin, end) of the frame set up above; may run
+// concurrently on disjoint ranges
+void updateWaveRange(Vertex *dst, const Vertex *src, unsigned begin, unsigned end);
+
+// A tile of a structured grid kept as an array of its own: tile column a,
+// row b is vertex a * (rows + 1) + b and lies on grid column
+// i0 + min(a, lastI), row j0 + min(b, lastJ), so a tile sticking out of the
+// grid repeats its edge.
+typedef struct {
+    unsigned i0, j0;
+    unsigned rows, cols;
+    unsigned lastI, lastJ;
+} WaveTile;
+
+// Split form for a grid drawn in tiles: beginWaveTiles() builds the
+// separable tables once for the whole grid, then updateWaveTileRange()
+// evaluates [begin, end) of any tile from them. The rest positions follow
+// from the tile's place in grid, and every field of dst is written, never
+// read, so dst may be a write-only mapping. EVAL_RECURRENCE runs direct,
+// its phasors belong to one array.
+void beginWaveTiles(WaveEval eval, const WaveGrid *grid, const sinewave *waves, unsigned nWaves, float time);
+void updateWaveTileRange(Vertex *dst, const WaveTile *tile, unsigned begin, unsigned end);
+
+// Structure-of-arrays mirror of a vertex array. x/z are loaded once, the
+// kernels read them with plain vector loads (no gathers) and write y/nx
+// into arrays of their own; the arrays live in one gridAlloc() block and
+// each is 64-byte aligned, so a band that starts at a multiple of
+// VERTEX_BAND_ALIGN starts on a cache line.
+typedef struct {
+    float *x, *z;
+    float *y, *nx;
+    unsigned count;
+    unsigned capacity;              // vertices the block has room for, only grows
+} WaveSoA;
+
+void loadWaveSoA(WaveSoA *soa, const Vertex *src, unsigned count);     // grows if needed, copies the vertices
+void freeWaveSoA(WaveSoA *soa);
+
+// updateWaveRange() through the mirror: evaluate [begin, end) into soa->y
+// and soa->nx, then scatter them into r.y/n.x of dst. Only direct
+// evaluation of the sine model runs on the mirror, any other frame (or a
+// mirror of a different size) falls back to updateWaveRange(dst, src, ...).
+void updateWaveSoARange(WaveSoA *soa, Vertex *dst, const Vertex *src, unsigned begin, unsigned end);
+
+// print ns per vertex and wave of the AoS kernels against the SoA ones
+// (with and without the scatter) for every kernel this CPU supports
+void benchWaveLayout(const Vertex *src, unsigned count, const sinewave *waves, unsigned nWaves);
+
+#endif //TOWERDEFENSESDL_WAVEKERNEL_H